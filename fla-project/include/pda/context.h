@@ -31,6 +31,9 @@ struct PDAContext {
     std::set<char> stack_alphabet;          // Γ
     char stack_start_symbol;                // Z0, '_' is used as empty
     DeltaMap transitions;                   // delta
+    // 同一个键上被后来的转移覆盖的转移。确定性运行只使用 transitions，
+    // 非确定性运行时它们与 transitions 一起构成转移关系
+    std::vector<DeltaMap::value_type> overridden;
 
     /**
      * Validate the PDA context.
@@ -41,7 +44,8 @@ struct PDAContext {
     bool validate() const;
 
     /**
-     * Add a transition to the transition table.
+     * Add a transition to the transition table. A transition with the same key replaces the
+     * existing one, which is kept in overridden unless the two are identical.
      * 
      * @param state The current state.
      * @param input_symbol The input symbol.
@@ -71,7 +75,12 @@ struct PDAContext {
                                   const char stack_top ) const; // X
 
 private:
-    
+
+    /**
+     * Check that one transition uses only declared states and symbols.
+     */
+    bool validTransition(const PDATransitionKey& key, const PDATransitionValue& value) const;
+
     /**
      * Get the transition from the transition table.
      * User will not need to use structure PDATransitionKey or PDATrasitionValue directly.
@@ -7,28 +7,83 @@
 #define FLA_PDA_EMULATOR_H
 
 #include "pda/context.h"
+#include "pda/graph_stack.h"
+#include "pda/input.h"
+#include "pda/program.h"
+#include "pda/run_length_stack.h"
+#include "pda/stack.h"
+#include <memory>
 #include <string>
 #include "utils/exception.h"
-#include <stack>
+#include "utils/run_limits.h"
+#include "utils/run_profile.h"
+
+/**
+ * Storage used for the stack during a run.
+ */
+enum class PDAStackBackend {
+    CONTIGUOUS,     // PDAStack, one byte per symbol
+    RUN_LENGTH,     // PDARunLengthStack, one entry per run of equal symbols
+};
+
+/**
+ * How a PDA run ended.
+ */
+enum class PDARunStatus {
+    ACCEPT,         // 接受
+    REJECT,         // 拒绝
+    STEP_LIMIT,     // 达到步数上限
+    TIME_LIMIT,     // 超过墙钟时间上限
+    MEMORY_LIMIT,   // 栈超过内存上限
+};
+
+/**
+ * The outcome of a PDA run, with the state it stopped in.
+ */
+struct PDARunResult {
+    PDARunStatus status = PDARunStatus::REJECT;
+    long long steps = 0;
+    std::string state;
+    size_t consumed = 0;        // 已经读入的输入符号数
+    size_t stack_high_water = 0;    // 运行中栈的最大深度
+};
 
 class PDAEmulator {
-    
-    PDAContext context;
+
+    // 运行时使用的编译后的转移表，可以与其他模拟器共享
+    std::shared_ptr<const PDAProgram> program;
+
+    // 复用的栈，避免每次运行重新分配；按 stack_backend 使用其中一个
+    PDAStackBackend stack_backend = PDAStackBackend::CONTIGUOUS;
+    PDAStack stack;
+    PDARunLengthStack run_length_stack;
 
     bool verbose_mode = false;
 
+    // 是否按非确定性 PDA 运行
+    bool nondeterministic = false;
+
+    // 步数、时间和栈大小的上限
+    RunLimits limits;
+
+    // 性能分析的结果，空表示不分析
+    RunProfile* profile = nullptr;
+
     enum class EmulatorState {
         NEW,            // 创建态
         RUNNING,        // 运行态
         ACCEPT,         // 接受态
         REJECT,         // 拒绝态
+        STEP_LIMIT,     // 达到步数上限
+        TIME_LIMIT,     // 超过时间上限
+        MEMORY_LIMIT,   // 栈超过上限
     };
 
     void verboseLog(const std::string& message);
 
     void verboseLogError(const std::string& message);
 
-    void verboseLogID(const std::string current_state, const std::stack<char>& stack, const int step_cnt);
+    void verboseLogID(const std::string current_state, const std::string& stack, const long long step_cnt);
 
     void verboseLogSyntaxError(const std::string& input, const int idx);
 
@@ -40,9 +95,46 @@ class PDAEmulator {
      */
     int checkSyntaxError(const std::string& input);
 
+    /**
+     * Fill in the rest of profile at the end of a run.
+     */
+    void finishProfile(long long steps, double seconds, size_t stack_high_water);
+
+    /**
+     * Run the PDA on a checked or incrementally checked input, using the chosen stack.
+     */
+    template <typename Input>
+    PDARunResult execute(Input& input);
+
+    template <typename Input, typename Stack>
+    PDARunResult execute(Input& input, Stack& stack);
+
+    /**
+     * Run the PDA nondeterministically with a PDAGraphStack.
+     */
+    template <typename Input>
+    PDARunResult executeNondeterministic(Input& input);
+
+    /**
+     * Set the status of a finished run and log it.
+     */
+    void reportEnd(EmulatorState e_state, PDARunResult& result);
+
 public:
     explicit PDAEmulator(const PDAContext& context);
 
+    /**
+     * Create an emulator sharing an already compiled program.
+     */
+    explicit PDAEmulator(std::shared_ptr<const PDAProgram> program);
+
+    /**
+     * @return The compiled program, to share with other emulators.
+     */
+    inline std::shared_ptr<const PDAProgram> getProgram() const {
+        return program;
+    }
+
     /**
      * Run the PDA emulator.
      * 
@@ -51,7 +143,61 @@ public:
      */
     bool run(const std::string& input);
 
+    /**
+     * Run the PDA emulator and report how the run ended.
+     *
+     * @param input The input string.
+     * @return The status of the run and the state it stopped in.
+     */
+    PDARunResult simulate(const std::string& input);
+
+    /**
+     * Run the PDA on the content of a file, "-" for stdin. Regular files are mapped, other
+     * files are read through a fixed-size buffer, so memory does not grow with the input.
+     * Symbols are checked as they are reached; a single newline at the end is ignored.
+     * Verbose mode does not print the input.
+     *
+     * @throws InputSyntaxError if the input has a symbol outside the input alphabet.
+     * @throws std::runtime_error if the file cannot be read.
+     */
+    PDARunResult simulateFile(const std::string& path);
+
     void setVerboseMode(bool mode);
+
+    /**
+     * Run later inputs as a nondeterministic PDA: every applicable transition is followed,
+     * including the epsilon transitions where a transition reading the input exists and the
+     * transitions in PDAContext::overridden. The input is accepted if some configuration
+     * is in a final state once the whole input is read.
+     *
+     * All the configurations at an input position share their stacks in a PDAGraphStack, so
+     * a run takes time and memory polynomial in the input length. Verbose mode prints only
+     * the input and the result, no profile is recorded, and the step limit counts applied
+     * transitions. The stack backend is not used.
+     */
+    void setNondeterministic(bool mode);
+
+    /**
+     * Choose the stack storage for later runs. The results do not depend on it, only
+     * memory use and speed (and so whether a memory limit is hit).
+     */
+    void setStackBackend(PDAStackBackend backend);
+
+    /**
+     * Limit the steps, wall-clock time and stack size of a run. A run hitting a limit stops
+     * with the matching PDARunStatus; run() reports it as not accepted.
+     * The time limit is checked once every few thousand steps.
+     */
+    void setLimits(const RunLimits& run_limits);
+
+    /**
+     * Count the steps of each transition of the following runs into profile, which also
+     * gets per-state counts, the fraction of epsilon moves, the deepest stack and the
+     * speed of the run.
+     *
+     * @param profile Owned by the caller, nullptr to disable.
+     */
+    void setProfile(RunProfile* profile);
 };
 
 #endif
\ No newline at end of file
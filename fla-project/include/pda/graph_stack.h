@@ -0,0 +1,144 @@
+/**
+ * Graph-structured stack for nondeterministic PDA runs.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_PDA_GRAPH_STACK_H
+#define FLA_PDA_GRAPH_STACK_H
+
+#include "pda/program.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * All the configurations of a nondeterministic PDA at one input position, with their
+ * stacks shared in one graph (GLR 式的图结构栈)。
+ *
+ * 每个节点是一个栈符号，below 是它下面所有可能的节点，nullptr 表示空栈。从栈顶节点沿 below
+ * 走到 nullptr 的每条路径都是一个栈，公共的栈底部分只存一次。
+ *
+ * 同一输入位置上：
+ * - 转移 t 压入的栈顶节点按 (下一状态, 栈顶符号) 合并，其余压入的节点按 (t, 第几个符号) 合并。
+ *   合并后的节点之上的后续运行只取决于合并键和之后的输入，与下面是什么无关，因此合并不改变语言；
+ * - 相同的 (状态, 栈顶节点) 只保留一个格局。
+ * 因此每个位置的节点数和格局数有与输入无关的上限，整个运行的时间和内存是输入长度的多项式。
+ *
+ * 节点在当前位置得到新的 below 时，已经在它上面做过的弹出会对新的 below 重做一次。
+ * 读入符号的转移在当前位置的空转移闭包完成后才做，那时当前位置的节点不会再变。
+ */
+class PDAGraphStack {
+public:
+    struct Node {
+        char symbol;
+        size_t position;            // 创建节点的输入位置
+        size_t height;              // 创建时沿第一个 below 的栈深度
+        std::vector<Node *> below;
+        std::vector<int32_t> pops;  // 在创建位置上从以该节点为栈顶的格局做过的空转移
+    };
+
+    struct Config {
+        int state;
+        Node *top;                  // nullptr 表示空栈
+
+        bool operator==(const Config &other) const {
+            return state == other.state && top == other.top;
+        }
+    };
+
+private:
+    struct ConfigHash {
+        size_t operator()(const Config &config) const {
+            return std::hash<const void *>()(config.top) * 31 + static_cast<size_t>(config.state);
+        }
+    };
+
+    const PDAProgram &program;
+
+    std::deque<Node> nodes;
+    size_t edges = 0;
+    size_t high_water = 0;
+    long long moves = 0;
+
+    // 当前位置
+    size_t position = 0;
+    std::vector<Config> configs;
+    std::unordered_set<Config, ConfigHash> seen;
+    std::unordered_map<uint64_t, Node *> merged;    // 合并键 -> 当前位置的节点
+    std::vector<Node *> created;                    // 当前位置创建的节点
+
+    // 空转移闭包中待处理的格局（configs 中的下标）和待重做的弹出
+    size_t next_config = 0;
+    std::vector<std::pair<int32_t, Node *>> pending_pops;
+
+    Node *mergedNode(uint64_t key, char symbol);
+
+    void addEdge(Node *node, Node *below);
+
+    void addConfig(int state, Node *top);
+
+    /**
+     * Apply transition t after its stack top was popped, leaving below on top.
+     */
+    void push(int32_t t, Node *below);
+
+    void startPosition(size_t new_position);
+
+public:
+
+    explicit PDAGraphStack(const PDAProgram &program);
+
+    /**
+     * Drop all the configurations and start again from the initial one at position 0.
+     */
+    void reset();
+
+    /**
+     * Take one step of the epsilon closure at the current position.
+     *
+     * @return false if the closure is complete.
+     */
+    bool step();
+
+    /**
+     * Apply the transitions reading an input symbol to every configuration and move to the
+     * next position. The closure at the current position must be complete.
+     */
+    void shift(int input);
+
+    inline const std::vector<Config> &getConfigs() const {
+        return configs;
+    }
+
+    inline size_t getPosition() const {
+        return position;
+    }
+
+    /**
+     * @return The number of transitions applied since reset().
+     */
+    inline long long getMoves() const {
+        return moves;
+    }
+
+    /**
+     * @return The largest depth of a stack built since reset().
+     */
+    inline size_t getHighWater() const {
+        return high_water;
+    }
+
+    /**
+     * @return The bytes held by the nodes and their edges, compared against the memory limit.
+     */
+    inline size_t memoryUsed() const {
+        return nodes.size() * sizeof(Node) + edges * sizeof(Node *);
+    }
+};
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * Input sources read symbol by symbol by PDAEmulator.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_PDA_INPUT_H
+#define FLA_PDA_INPUT_H
+
+#include "pda/program.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Input held in memory, e.g. a string or a mapped file.
+ * 输入按块对照输入字母表检查，模拟器读到某一块之前才检查它，因此映射的大文件只需顺序读一遍。
+ *
+ * 两种输入的接口相同：atEnd() 在需要时准备下一块输入，current() 和 advance() 读取当前符号，
+ * finish() 检查剩余的输入。遇到不在输入字母表中的符号时抛出 InputSyntaxError。
+ */
+class PDAMemoryInput {
+    const PDAProgram &program;
+    const char *data;
+    size_t size;
+    size_t pos = 0;
+    size_t checked;         // [0, checked) 已经检查过
+    std::string name;
+
+    bool checkMore();
+
+public:
+
+    /**
+     * @param checked The length of a prefix already known to be valid.
+     * @param name Names the input in error messages.
+     */
+    PDAMemoryInput(const PDAProgram &program, const char *data, size_t size, size_t checked, std::string name);
+
+    inline bool atEnd() {
+        return pos >= checked && !checkMore();
+    }
+
+    inline char current() const {
+        return data[pos];
+    }
+
+    inline void advance() {
+        pos++;
+    }
+
+    inline size_t position() const {
+        return pos;
+    }
+
+    /**
+     * Check the part of the input not read yet.
+     */
+    void finish();
+};
+
+/**
+ * Input read from a file descriptor through a fixed-size buffer, so memory does not grow
+ * with the input. 结尾的一个换行符被忽略，方便从管道读入 echo 的输出。
+ */
+class PDAStreamInput {
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    const PDAProgram &program;
+    int fd;
+    std::string name;
+
+    std::vector<char> buffer;
+    size_t offset = 0;      // buffer[0] 在输入中的位置
+    size_t pos = 0;
+    size_t len = 0;
+    bool eof = false;
+    bool held_newline = false;  // 缓冲区末尾的换行符留到下一次读入，以判断它是否是输入的最后一个字节
+
+    bool refill();
+
+public:
+
+    /**
+     * @param fd The descriptor to read, not closed by the input.
+     * @param name Names the input in error messages.
+     */
+    PDAStreamInput(const PDAProgram &program, int fd, std::string name);
+
+    inline bool atEnd() {
+        return pos >= len && !refill();
+    }
+
+    inline char current() const {
+        return buffer[pos];
+    }
+
+    inline void advance() {
+        pos++;
+    }
+
+    inline size_t position() const {
+        return offset + pos;
+    }
+
+    /**
+     * Read and check the rest of the input.
+     */
+    void finish();
+};
+
+#endif
@@ -9,33 +9,38 @@
 
 #include "pda/context.h"
 #include <string>
-#include <regex>
 #include "utils/exception.h"
+#include "utils/parse_token.h"
 
 class PDAParser {
     /**
      * Parse a line to PDA context.
      * 
-     * @param line The line to parse.
+     * @param tokenizer The tokenizer positioned at the line to parse.
      */
-    static void parseLine(const std::string& line, PDAContext& context);
+    static void parseLine(const LineTokenizer& tokenizer, PDAContext& context);
 
-    static void linePreprocess(std::string& line);
-
-    static std::set<std::string> control_tokens;
-
-    static std::regex state_regex;
+    static bool isControlToken(StringView token);
 
     static bool isValidSymbol(char c);
 
+
 public:
     /**
-     * Parse a PDA configuration file.
+     * Parse a PDA configuration file. The file is mapped into memory and tokenized in place.
      * 
      * @param filepath The filepath of the configuration file.
      * @return The PDA context parsed from the file.
      */
     static PDAContext parse(const std::string& filepath);
+
+    /**
+     * Parse the content of a PDA configuration file.
+     *
+     * @param content The text of the configuration file.
+     * @return The PDA context parsed from it.
+     */
+    static PDAContext parseContent(StringView content);
 };
 
 #endif
\ No newline at end of file
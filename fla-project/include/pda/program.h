@@ -0,0 +1,251 @@
+/**
+ * Compiled form of a PDA, used by PDAEmulator at run time.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_PDA_PROGRAM_H
+#define FLA_PDA_PROGRAM_H
+
+#include "pda/context.h"
+#include "utils/string_view.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A PDAContext compiled into integer form.
+ *
+ * 状态、输入符号和栈符号都被编号为从 0 开始的小整数（按 std::set 的顺序），转移函数被展开为一张以
+ * (状态编号, 输入符号编号, 栈顶符号编号) 为下标的稠密表。输入符号编号 input_num 表示输入已经读完。
+ * 没有直接可用的转移时退回空转移的规则也在展开时处理好了：表项直接就是最终选中的转移，
+ * 并带有是否读入一个输入符号的标记，因此每步只需一次查表。
+ *
+ * 栈操作存放在同一个符号池中，转移 t 的栈操作为 actions[action_offsets[t], action_offsets[t + 1])，
+ * 编译时已经反转为压栈的顺序，因此可以整段复制到栈上。栈上存放的仍是原始字符。
+ *
+ * 非确定性运行使用另一张按 (状态, 输入符号或空, 栈顶) 排序的键表，列出所有可用的转移，
+ * 包括 PDAContext::overridden 中的转移（它们的编号排在 transitions 之后）。
+ *
+ * Should be created with PDAProgram::compile() from a validated PDAContext, or loaded from
+ * a .pdac file with PDAProgram::load().
+ */
+class PDAProgram {
+public:
+    // 稠密表的最大表项数，超过后退化为逐步查询 DeltaMap
+    static const size_t MAX_DENSE_ENTRIES = 1 << 22;
+
+    // lookup() 的返回值：最低位表示是否读入一个输入符号，其余为转移编号；NONE 表示没有可用的转移
+    static const int32_t NONE = -1;
+
+    // .pdac 文件的格式版本。compile() 的结果改变时也要增加，使旧的预编译文件和缓存失效
+    static const uint32_t FILE_VERSION = 4;
+
+private:
+    std::vector<std::string> state_names;
+    std::vector<char> final_flags;              // indexed by state id
+    int start_state = 0;
+    char start_symbol = '_';
+
+    std::vector<char> input_symbols;            // input symbol id -> char
+    std::vector<char> stack_symbols;            // stack symbol id -> char
+    int16_t input_ids[256];                     // char -> input symbol id, -1 if not in input alphabet
+    int16_t stack_ids[256];                     // char -> stack symbol id, -1 if never on the stack
+    int stack_num = 0;
+
+    // transitions 中的转移数，被覆盖的转移排在它们之后，共 transition_num 个
+    int rule_num = 0;
+    int transition_num = 0;
+    uint32_t move_key_num = 0;
+
+    // 下面的大数组存放在 storage 中：compile() 时为 vector，load() 时直接指向映射的 .pdac 文件。
+    // 复制 PDAProgram 时共享同一份 storage。
+    std::shared_ptr<const void> storage;
+
+    // 转移 t 的内容，下一状态为 -1 的转移视为不存在
+    const int32_t *next_states = nullptr;
+    const uint32_t *action_offsets = nullptr;   // transition_num + 1 of them
+    const char *actions = nullptr;              // 各转移的栈操作，反转为压栈的顺序
+
+    // 转移 t 在源文件中的源状态 sources[t]、输入符号 patterns[2t] 和栈顶符号 patterns[2t + 1]，
+    // 只用于性能分析的报告
+    const int32_t *sources = nullptr;
+    const char *patterns = nullptr;
+
+    // ((state * (input_num + 1) + input) * stack_num + top) -> lookup() 的返回值
+    const int32_t *table = nullptr;
+
+    // 非确定性运行的转移关系：升序的 moveKey() 列表，键 move_keys[i] 对应
+    // moves[move_offsets[i], move_offsets[i + 1])
+    const uint64_t *move_keys = nullptr;
+    const uint32_t *move_offsets = nullptr;
+    const int32_t *moves = nullptr;
+
+    inline uint64_t moveKey(int state, int input, int top_id) const {
+        return (static_cast<uint64_t>(state) * (input_symbols.size() + 1) + input) * stack_num + top_id;
+    }
+
+    // 稠密表过大时使用的后备查询
+    bool dense = false;
+    DeltaMap fallback;
+
+    // 与程序一起保存的源文件内容，指向映射的文件，见 getSource()
+    StringView source;
+
+    int32_t lookupFallback(int state, int input, char top) const;
+
+public:
+
+    /**
+     * Compile a PDA context. The context must be valid.
+     */
+    static PDAProgram compile(const PDAContext &context);
+
+    /**
+     * Write the program to a precompiled .pdac file, see src/pda/program_file.cpp for the layout.
+     * The file is written next to the target and renamed over it.
+     *
+     * @param source_text The machine file the program was compiled from, stored so that a
+     *                    cache hit can be confirmed with getSource(); may be empty.
+     * @throws std::runtime_error if the program is not dense or the file cannot be written.
+     */
+    void save(const std::string &path, StringView source_text = StringView()) const;
+
+    /**
+     * Load a program written by save(). 文件被映射到内存中直接使用，检查文件头、各部分的大小和
+     * 每一项的取值范围，不解析转移，也不为转移分配内存。
+     *
+     * @throws std::runtime_error if the file cannot be read or is not a valid .pdac file
+     *         of this version.
+     */
+    static std::shared_ptr<const PDAProgram> load(const std::string &path);
+
+    /**
+     * Find the move for a state, the next input symbol and the stack top: the transition
+     * for that input symbol if there is one, otherwise the epsilon transition.
+     *
+     * @param input The input symbol id, or getInputNum() at the end of the input.
+     * @return (transition << 1) | consumes, where consumes tells whether the move reads
+     *         the input symbol; NONE if no transition applies.
+     */
+    inline int32_t lookup(int state, int input, char top) const {
+        int16_t top_id = stack_ids[static_cast<uint8_t>(top)];
+        if (top_id < 0) {
+            return NONE;
+        }
+        if (!dense) {
+            return lookupFallback(state, input, top);
+        }
+        return table[(static_cast<size_t>(state) * (input_symbols.size() + 1) + input) * stack_num + top_id];
+    }
+
+    /**
+     * Find every transition for a state, an input symbol (or epsilon) and the stack top,
+     * for nondeterministic runs.
+     *
+     * @param input The input symbol id, or getInputNum() for the epsilon transitions.
+     * @return The transitions, count of them; nullptr if there are none.
+     */
+    inline const int32_t* getMoves(int state, int input, char top, size_t &count) const {
+        int16_t top_id = stack_ids[static_cast<uint8_t>(top)];
+        const uint64_t *end = move_keys + move_key_num;
+        uint64_t key = top_id < 0 ? 0 : moveKey(state, input, top_id);
+        const uint64_t *it = top_id < 0 ? end : std::lower_bound(move_keys, end, key);
+        if (it == end || *it != key) {
+            count = 0;
+            return nullptr;
+        }
+        size_t i = static_cast<size_t>(it - move_keys);
+        count = move_offsets[i + 1] - move_offsets[i];
+        return moves + move_offsets[i];
+    }
+
+    inline int getInputNum() const {
+        return static_cast<int>(input_symbols.size());
+    }
+
+    inline int encodeInput(char ch) const {
+        return input_ids[static_cast<uint8_t>(ch)];
+    }
+
+    inline bool isInputSymbol(char ch) const {
+        return input_ids[static_cast<uint8_t>(ch)] >= 0;
+    }
+
+    inline int getStateNum() const {
+        return static_cast<int>(state_names.size());
+    }
+
+    inline int getTransitionNum() const {
+        return transition_num;
+    }
+
+    /**
+     * @return The number of transitions of the machine once later duplicates have replaced
+     *         earlier ones; they are numbered first, before the overridden transitions.
+     */
+    inline int getRuleNum() const {
+        return rule_num;
+    }
+
+    inline int getStartState() const {
+        return start_state;
+    }
+
+    inline char getStartSymbol() const {
+        return start_symbol;
+    }
+
+    inline bool isFinal(int state) const {
+        return final_flags[state];
+    }
+
+    inline bool isDense() const {
+        return dense;
+    }
+
+    /**
+     * @return The source text stored by save() in the file this program was loaded from,
+     *         empty if there is none.
+     */
+    inline StringView getSource() const {
+        return source;
+    }
+
+    inline const std::string& getStateName(int state) const {
+        return state_names[state];
+    }
+
+    inline int getNextState(int32_t transition) const {
+        return next_states[transition];
+    }
+
+    inline int getSource(int32_t transition) const {
+        return sources[transition];
+    }
+
+    /**
+     * @return Whether the transition reads no input symbol.
+     */
+    inline bool isEpsilon(int32_t transition) const {
+        return patterns[2 * transition] == '_';
+    }
+
+    /**
+     * @return The transition as written in the source file, e.g. "q0 a z q1 1z".
+     */
+    std::string describeTransition(int32_t transition) const;
+
+    /**
+     * @return The symbols the transition pushes after popping the stack top, in push order
+     *         (the stack action reversed, so its first symbol is pushed last and ends up on top).
+     */
+    inline const char* getPush(int32_t transition, size_t &len) const {
+        len = action_offsets[transition + 1] - action_offsets[transition];
+        return actions + action_offsets[transition];
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * Run-length encoded PDA stack.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_PDA_RUN_LENGTH_STACK_H
+#define FLA_PDA_RUN_LENGTH_STACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A PDA stack storing runs of equal symbols as (symbol, count) pairs, bottom run first.
+ * 像 a^n b^n 这样把同一个符号压入 n 次的机器，栈上只有常数个段，内存与栈深度无关；
+ * 压入或弹出与栈顶相同的符号只需修改栈顶段的计数。
+ * 接口与 PDAStack 相同，PDAEmulator 可以用任意一种栈运行。
+ */
+class PDARunLengthStack {
+    struct Run {
+        char symbol;
+        size_t count;
+    };
+
+    std::vector<Run> runs;
+    size_t depth = 0;
+    size_t high_water = 0;
+
+    inline void push(char symbol) {
+        if (!runs.empty() && runs.back().symbol == symbol) {
+            runs.back().count++;
+        } else {
+            runs.push_back(Run{symbol, 1});
+        }
+    }
+
+public:
+
+    /**
+     * Empty the stack and put the bottom symbol on it.
+     */
+    void reset(char bottom);
+
+    inline bool empty() const {
+        return depth == 0;
+    }
+
+    inline size_t size() const {
+        return depth;
+    }
+
+    inline char top() const {
+        return runs.back().symbol;
+    }
+
+    /**
+     * Pop the top symbol and push len symbols, given in push order: symbols[len - 1]
+     * ends up on top. The stack must not be empty.
+     */
+    inline void replaceTop(const char *symbols, size_t len) {
+        // 压入的第一个符号与栈顶相同（例如只读入输入、不改变栈的转移）时，栈顶段不变
+        size_t i = 0;
+        if (len > 0 && symbols[0] == runs.back().symbol) {
+            i = 1;
+        } else if (--runs.back().count == 0) {
+            runs.pop_back();
+        }
+        for (; i < len; i++) {
+            push(symbols[i]);
+        }
+        depth = depth - 1 + len;
+        if (depth > high_water) {
+            high_water = depth;
+        }
+    }
+
+    /**
+     * @return The largest depth since the last reset().
+     */
+    inline size_t getHighWater() const {
+        return high_water;
+    }
+
+    /**
+     * @return The bytes holding the stack content, compared against the memory limit.
+     */
+    inline size_t memoryUsed() const {
+        return runs.size() * sizeof(Run);
+    }
+
+    /**
+     * @return The symbols on the stack, top first.
+     */
+    std::string contents() const;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * Define the PDA stack.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_PDA_STACK_H
+#define FLA_PDA_STACK_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * A PDA stack backed by one contiguous buffer, bottom at index 0.
+ * 缓冲区按倍数扩容，一步转移（弹出栈顶再压入栈操作）只是一次 memcpy 和一次下标调整。
+ * 同时记录运行中栈的最大深度。
+ */
+class PDAStack {
+    std::vector<char> buffer;
+    size_t depth = 0;
+    size_t high_water = 0;
+
+    void grow(size_t min_size);
+
+public:
+
+    /**
+     * Empty the stack and put the bottom symbol on it.
+     */
+    void reset(char bottom);
+
+    inline bool empty() const {
+        return depth == 0;
+    }
+
+    inline size_t size() const {
+        return depth;
+    }
+
+    inline char top() const {
+        return buffer[depth - 1];
+    }
+
+    /**
+     * Pop the top symbol and push len symbols, given in push order: symbols[len - 1]
+     * ends up on top. The stack must not be empty.
+     */
+    inline void replaceTop(const char *symbols, size_t len) {
+        size_t new_depth = depth - 1 + len;
+        if (new_depth > buffer.size()) {
+            grow(new_depth);
+        }
+        if (len > 0) {
+            std::memcpy(&buffer[depth - 1], symbols, len);
+        }
+        depth = new_depth;
+        if (depth > high_water) {
+            high_water = depth;
+        }
+    }
+
+    /**
+     * @return The largest depth since the last reset().
+     */
+    inline size_t getHighWater() const {
+        return high_water;
+    }
+
+    /**
+     * @return The bytes holding the stack content, compared against the memory limit.
+     */
+    inline size_t memoryUsed() const {
+        return depth;
+    }
+
+    /**
+     * @return The symbols on the stack, top first.
+     */
+    std::string contents() const;
+};
+
+#endif
@@ -36,6 +36,7 @@ struct PDATransitionKeyHash {
 struct PDATransitionValue {
     std::string next_state;   // next state
     std::string stack_action; // stack action
+    int id = -1;              // order of insertion, assigned by PDAContext::addTransition
 
     PDATransitionValue(std::string next_state, std::string stack_action);
 
@@ -46,8 +47,9 @@ struct PDAQueryResult {
     std::string next_state;
     std::string stack_action;
     bool success;
+    int id = -1;              // the transition id, -1 if no transition applies
 
-    PDAQueryResult(std::string next_state, std::string stack_action);
+    PDAQueryResult(std::string next_state, std::string stack_action, int id);
 
     PDAQueryResult();
 };
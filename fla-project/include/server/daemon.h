@@ -0,0 +1,75 @@
+/**
+ * Long-running server answering run requests over a Unix domain socket.
+ */
+
+#ifndef FLA_SERVER_DAEMON_H
+#define FLA_SERVER_DAEMON_H
+
+#include "server/machine_cache.h"
+#include "tm/emulator.h"
+#include "utils/run_limits.h"
+#include <functional>
+#include <string>
+
+/**
+ * Serves runs of machine files, keeping parsed machines in a MachineCache so repeated
+ * requests skip the parser and the TM compilation.
+ *
+ * 协议：每个消息是一帧，u32 小端序的长度后接该长度的内容，最长 MAX_FRAME 字节。
+ * 一个连接上可以依次发送多个请求，每个请求对应一个响应。
+ *
+ *   请求：<机器文件路径>\n<步数上限，0 表示不限>\n<输入串>
+ *   响应：<状态>\n<内容>
+ *
+ * 状态为 ok 时内容是 TM 纸带上的结果，或者 PDA 的 true / false；
+ * 其他状态为 illegal input、non-halting、step limit、time limit、memory limit、
+ * syntax error 和 error，后两者的内容是错误信息。
+ *
+ * 主线程等待所有连接上的请求，每个到达的请求交给 workers 个工作线程之一处理，处理完后连接回到主线程。
+ * 因此工作线程只在处理请求时被占用，空闲的连接不会让其他客户端等待；工作线程都在忙时请求在队列中等待。
+ * 读写一帧超过 IO_TIMEOUT_MS 毫秒时关闭该连接。
+ */
+class Daemon {
+public:
+    // 为每个请求新建的 TM 模拟器设置选项
+    using TMConfigurer = std::function<void(TMEmulator &)>;
+
+    static const uint32_t MAX_FRAME = 16u << 20;
+
+    static const int IO_TIMEOUT_MS = 2000;
+
+private:
+    std::string socket_path;
+    int workers;
+    RunLimits limits;
+    TMConfigurer configure;
+    MachineCache cache;
+
+    /**
+     * Read one request from the connection and answer it.
+     *
+     * @return false if the connection is closed, broken or timed out.
+     */
+    bool serveRequest(int fd);
+
+    std::string handle(const std::string &request);
+
+public:
+
+    /**
+     * @param socket_path Path of the socket, an existing file there is replaced.
+     * @param workers The number of worker threads, at least 1.
+     * @param limits Limits applied to every run. A request may only lower the step limit.
+     * @param configure Applied to each TM emulator before its run.
+     */
+    Daemon(const std::string &socket_path, int workers, const RunLimits &limits, TMConfigurer configure);
+
+    /**
+     * Listen on the socket and serve connections until the process is killed.
+     *
+     * @throws std::runtime_error if the socket cannot be set up.
+     */
+    void serve();
+};
+
+#endif
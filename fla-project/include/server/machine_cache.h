@@ -0,0 +1,64 @@
+/**
+ * Compiled machines kept across requests by the daemon.
+ */
+
+#ifndef FLA_SERVER_MACHINE_CACHE_H
+#define FLA_SERVER_MACHINE_CACHE_H
+
+#include "pda/program.h"
+#include "tm/program.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A parsed machine, either a TM or a PDA.
+ */
+struct CachedMachine {
+    std::shared_ptr<const TMProgram> tm;       // .tm / .tmc 文件，否则为空
+    std::shared_ptr<const PDAProgram> pda;     // .pda / .pdac 文件，否则为空
+};
+
+/**
+ * Machines keyed by file path and the file's stat data.
+ *
+ * 每次请求只 stat 文件，设备号、inode、修改时间或大小改变（文件被改写或替换）后才重新读入并解析，
+ * 因此不需要监视文件。解析在锁外进行，多个线程同时解析同一个文件时以后完成的为准。
+ */
+class MachineCache {
+    static const size_t MAX_ENTRIES = 64;
+
+    // 判断文件是否改变的 stat 数据
+    struct FileStamp {
+        uint64_t dev, ino, size;
+        int64_t mtime_sec, mtime_nsec;
+
+        bool operator==(const FileStamp &other) const {
+            return dev == other.dev && ino == other.ino && size == other.size && mtime_sec == other.mtime_sec &&
+                   mtime_nsec == other.mtime_nsec;
+        }
+    };
+
+    struct Entry {
+        FileStamp stamp;
+        CachedMachine machine;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+
+public:
+
+    /**
+     * Get the machine in the file at path, loading it only if the file is not cached
+     * or has changed since it was cached.
+     *
+     * @throws std::runtime_error if the file cannot be read, std::invalid_argument if the
+     *         extension is not .tm, .tmc, .pda or .pdac, and the parsers' exceptions.
+     */
+    CachedMachine get(const std::string &path);
+};
+
+#endif
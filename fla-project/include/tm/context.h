@@ -41,8 +41,8 @@ struct TMContext {
     bool validate() const;
 
 
-    bool addTransition(const std::string &state, const std::string& input_chars, const std::string &replace_chars,
-                       const std::vector<TapeDirection> &tape_directions, const std::string &next_state);
+    bool addTransition(std::string state, std::string input_chars, std::string replace_chars,
+                       const std::vector<TapeDirection> &tape_directions, std::string next_state);
 
     TMQueryResult getTransition(const std::string& state, const std::string& input_chars) const;
 
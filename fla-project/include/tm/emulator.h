@@ -8,29 +8,139 @@
 #define FLA_TM_EMULATOR_H
 
 #include "tm/context.h"
+#include "tm/loop_detector.h"
+#include "tm/program.h"
+#include "tm/snapshot.h"
 #include "tm/tape.h"
+#include "tm/trace_writer.h"
 #include "utils/exception.h"
+#include "utils/run_limits.h"
+#include "utils/run_profile.h"
+#include <csignal>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+/**
+ * Storage used for the tapes during a run.
+ */
+enum class TMTapeBackend {
+    VECTOR,     // TMTape, one byte per cell
+    PACKED,     // TMPackedTape, 1, 2 or 4 bits per cell depending on the tape alphabet
+    MAPPED,     // TMMappedTape, reserved virtual memory committed on demand
+};
+
+/**
+ * Which configurations verbose mode prints, and how much of each tape.
+ * The last configuration of a run is always printed.
+ */
+struct TMTraceOptions {
+    long long every = 1;            // 只输出步数为 every 的倍数的格局
+    bool state_changes = false;     // 只输出状态与上一步不同的格局（以及第 0 步）
+    int window = 0;                 // 只输出读头两侧各 window 格内的非空白内容，0 表示不限
+};
+
+/**
+ * How a TM run ended.
+ */
+enum class TMRunStatus {
+    ACCEPT,         // 到达终止状态
+    HALT,           // 没有可用的转移
+    NON_HALTING,    // 检测到循环，机器永远不会停机
+    STEP_LIMIT,     // 达到步数上限
+    TIME_LIMIT,     // 超过墙钟时间上限
+    MEMORY_LIMIT,   // 纸带超过内存上限
+    INTERRUPTED,    // 收到停止请求，已保存快照
+};
+
+/**
+ * The outcome of a TM run.
+ */
+struct TMRunResult {
+    TMRunStatus status = TMRunStatus::HALT;
+
+    // 纸带 0 上的非空白内容；运行被提前停止时为停止时的内容
+    std::string output;
+
+    long long steps = 0;
+
+    // 停止时所在的状态
+    std::string state;
+
+    // NON_HALTING 时发现的循环
+    TMCycle cycle;
+};
+
 class TMEmulator {
 
-    TMContext context;
+    std::shared_ptr<const TMProgram> program;
 
     bool verbose_mode = false;
 
+    TMTraceOptions trace_options;
+
+    // verbose 输出先写入缓冲区，运行结束或输出到 stderr 之前再写出
+    TMTraceWriter tracer{std::cout};
+
+    // 上一次输出的格局的步数，以及上一步的状态，用于采样
+    long long trace_last_step = -1;
+    int trace_prev_state = -1;
+
+    // 渲染纸带时复用的缓冲区
+    std::string trace_cells;
+
+    TMTapeBackend tape_backend = TMTapeBackend::VECTOR;
+
+    // 步数、时间和每条纸带内存的上限
+    RunLimits limits;
+
+    bool accelerated = false;
+
+    // 宏机器模式下每块的格子数，0 表示不使用
+    int macro_block = 0;
+
+    bool detect_loops = false;
+
+    // 快照文件，以及保存快照的步数间隔（0 表示只在收到停止请求时保存）
+    std::string checkpoint_path;
+    long long checkpoint_interval = 0;
+
+    // 二进制轨迹文件（空表示不记录），以及保存关键帧的步数间隔（0 表示不保存）
+    std::string trace_path;
+    long long keyframe_interval = 0;
+
+    // 性能分析的结果，空表示不分析
+    RunProfile *profile = nullptr;
+
+    // 由 requestStop() 设置，可以在信号处理函数中使用
+    static volatile std::sig_atomic_t stop_requested;
+
     enum class EmulatorState {
         NEW,
         RUNNING,
         ACCEPT,
         HALT,
+        LOOPING,
+        STEP_LIMIT,
+        TIME_LIMIT,
+        MEMORY_LIMIT,
+        INTERRUPTED,
     };
 
     void verboseLog(const std::string &message);
 
     void verboseLogError(const std::string &message);
 
-    void verboseLogID(const std::string &current_state, const std::vector<TMTape> &tapes, const int step_cnt);
+    /**
+     * Print the configuration if trace_options select it.
+     *
+     * @param last Whether this is the last configuration of the run, which is printed
+     *             unless it already was.
+     */
+    template <typename Tape>
+    void verboseLogID(const int current_state, const std::vector<Tape> &tapes, const long long step_cnt,
+                      bool last = false);
 
     void verboseLogSyntaxError(const std::string& input, const int idx);
 
@@ -43,10 +153,56 @@ class TMEmulator {
 
     int checkSyntaxError(const std::string &input);
 
+    /**
+     * Build the result of a run that stopped in e_state, and log it.
+     */
+    TMRunResult finish(EmulatorState e_state, int state, const std::string &output, long long steps,
+                       const TMCycle &cycle = TMCycle());
+
+    /**
+     * Run the TM on a syntax checked input, or from a snapshot if from is not null,
+     * with the tapes chosen by tape_backend.
+     */
+    TMRunResult start(const std::string &input, const TMSnapshot *from);
+
+    /**
+     * Run the TM with tapes of type Tape.
+     */
+    template <typename Tape>
+    TMRunResult execute(const std::string &input, const TMSnapshot *from);
+
+    template <typename Tape>
+    TMSnapshot takeSnapshot(int state, const std::vector<Tape> &tapes, long long step_cnt) const;
+
+    /**
+     * Fill in the rest of profile at the end of a run.
+     *
+     * @param head_min, head_max The leftmost and rightmost cells each tape used.
+     */
+    void finishProfile(long long steps, double seconds, const std::vector<int> &head_min,
+                       const std::vector<int> &head_max);
+
+    /**
+     * Run a single tape TM as a macro machine over blocks of macro_block cells.
+     */
+    TMRunResult executeMacro(const std::string &input);
+
 public:
     
     explicit TMEmulator(const TMContext &context);
 
+    /**
+     * Create an emulator sharing an already compiled program.
+     */
+    explicit TMEmulator(std::shared_ptr<const TMProgram> program);
+
+    /**
+     * @return The compiled program, to share with other emulators.
+     */
+    inline std::shared_ptr<const TMProgram> getProgram() const {
+        return program;
+    }
+
     /**
      * Run the TM emulator
      *
@@ -55,7 +211,109 @@ public:
      */
     std::string run(const std::string &input);
 
+    /**
+     * Run the TM emulator and report how the run ended.
+     *
+     * @param input The input string.
+     * @return The status, output and step count of the run.
+     */
+    TMRunResult simulate(const std::string &input);
+
+    /**
+     * Continue a run from a snapshot saved by a checkpoint, without replaying it.
+     * Step counts in the result include the steps before the snapshot.
+     *
+     * @throws std::runtime_error if the snapshot was taken from a different machine.
+     */
+    TMRunResult resume(const TMSnapshot &snapshot);
+
     void setVerboseMode(bool mode);
+
+    /**
+     * Choose which configurations verbose mode prints, so that long runs can be traced.
+     */
+    void setTraceOptions(const TMTraceOptions &options);
+
+    /**
+     * Choose the tape storage. PACKED falls back to VECTOR if the tape alphabet
+     * has more than 16 symbols.
+     */
+    void setTapeBackend(TMTapeBackend backend);
+
+    /**
+     * Limit the memory of each tape, the same as limits.max_memory in setLimits().
+     *
+     * @param bytes The limit in bytes, 0 for no limit.
+     */
+    void setTapeMemoryLimit(size_t bytes);
+
+    /**
+     * Limit the steps, wall-clock time and memory of each tape of a run. A run hitting
+     * a limit stops with the matching TMRunStatus and the state it reached; if a tape
+     * outgrows the memory limit, the step needing it may be partly applied.
+     * The time limit is checked once every few thousand steps. Macro mode is not used
+     * with a step limit, since it moves many steps at once.
+     */
+    void setLimits(const RunLimits &run_limits);
+
+    /**
+     * Skip over runs of equal cells in one go when the machine sweeps a tape with a
+     * self loop that changes nothing. Step counts are the same as without it.
+     * Has no effect in verbose mode, where every step is printed.
+     */
+    void setAccelerated(bool mode);
+
+    /**
+     * Run single tape TMs as a macro machine: k consecutive cells form one macro symbol,
+     * and the effect of running inside a block is cached by (state, block contents, head offset).
+     * Final tapes and step counts are the same as without it. Multi-tape TMs and
+     * verbose mode run normally.
+     *
+     * @param k The block size, 2 to 8. 0 or 1 to disable.
+     */
+    void setMacroBlock(int k);
+
+    /**
+     * Watch the run for cycles (see TMLoopDetector) and stop with TMRunStatus::NON_HALTING
+     * when the machine provably never halts. Macro mode is not used while this is on.
+     */
+    void setLoopDetection(bool mode);
+
+    /**
+     * Save a TMSnapshot of the run to path every interval steps, and when requestStop()
+     * is called, after which the run stops with TMRunStatus::INTERRUPTED.
+     * Macro mode is not used while checkpointing.
+     *
+     * @param path The snapshot file, empty to disable.
+     * @param interval The number of steps between two snapshots, 0 to only save on requestStop().
+     */
+    void setCheckpoint(const std::string &path, long long interval);
+
+    /**
+     * Record every step of the following runs to a binary trace (see TMTraceRecorder),
+     * which `fla trace render` turns back into verbose output. Runs that record go
+     * step by step: sweeps are not skipped and macro mode is not used.
+     *
+     * @param path The trace file, empty to disable.
+     * @param interval The number of steps between two keyframes, from which a replay can
+     *                 start instead of step 0; 0 for no keyframes.
+     */
+    void setTraceFile(const std::string &path, long long interval);
+
+    /**
+     * Count the steps of each transition of the following runs into profile, which
+     * also gets per-state counts, tape high-water marks and the speed of the run.
+     * Runs that profile go step by step: sweeps are not skipped and macro mode is not used.
+     *
+     * @param profile Owned by the caller, nullptr to disable.
+     */
+    void setProfile(RunProfile *profile);
+
+    /**
+     * Ask running emulators that checkpoint to save a snapshot and stop.
+     * Async-signal-safe, meant to be called from a SIGTERM handler.
+     */
+    static void requestStop();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,256 @@
+/**
+ * Detect TM runs that provably never halt.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_LOOP_DETECTOR_H
+#define FLA_TM_LOOP_DETECTOR_H
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * A cycle found by TMLoopDetector.
+ */
+struct TMCycle {
+    long long length = 0;       // 一个循环的步数
+    long long found_at = 0;     // 发现循环时的步数
+    int shift = 0;              // 每个循环中纸带 0 读头的位移，0 表示同一个格局原样重复
+};
+
+/**
+ * Watch a run of a TM step by step and report when it is stuck in a cycle.
+ *
+ * 两种判定方法：
+ * 1. 每隔一段步数对完整格局（状态、各纸带非空白内容及读头相对内容的位置）取快照，
+ *    用 Brent 算法与保存的快照比较。内容相同时格局原样重复，或整体平移后重复，之后必然一直循环。
+ *    发现重复后继续逐步运行，找出最短的循环长度。
+ * 2. 单纸带时，记录读头每次走到新的最右（最左）位置时的状态。两次破纪录状态相同，
+ *    且两次之间读头回退所及的窗口内容也相同时，机器会一边向该方向平移一边重复同样的过程。
+ *    窗口长度不超过 WINDOW。
+ *
+ * 两种方法都只在确定不停机时才报告，不会误判。
+ * Tape is any tape type TMEmulator runs with.
+ */
+template <typename Tape>
+class TMLoopDetector {
+    // 两次快照之间的最少步数
+    static const long long SAMPLE_INTERVAL = 1 << 12;
+
+    // 平移检测比较的窗口长度上限
+    static const int WINDOW = 1 << 10;
+
+    struct Snapshot {
+        int state = -1;
+        long long step = 0;
+        std::vector<int> heads;
+        std::vector<int> lefts;             // 各纸带快照内容最左格子的位置
+        std::vector<std::string> cells;
+        size_t hash = 0;
+    };
+
+    // 向一侧的破纪录记录，坐标 x = dir * 位置，因此两侧都按“越大越远”处理
+    struct Side {
+        int dir;
+        int bound;                          // x 不小于 bound 时，更远的格子都是空白
+        int record = INT_MIN;
+        int back = INT_MAX;                 // 上次破纪录以来读头最小的 x
+        std::vector<int> lows;              // lows[j]：第 j - 1 次到第 j 次破纪录之间读头最小的 x
+
+        // 每个状态最近一次破纪录的编号、步数、位置和窗口内容（按 x 递增的顺序），编号 -1 表示没有
+        std::vector<int> last;
+        std::vector<long long> last_step;
+        std::vector<int> last_x;
+        std::vector<std::string> last_window;
+    };
+
+    const int tape_num;
+
+    // Brent 算法保存的快照，以及快照计数
+    Snapshot saved;
+    long long samples = 0;
+    long long power = 1;
+    long long next_sample = 0;
+
+    // 快照重复后等待确认最短循环；period_bound 为两次重复快照的步数差，0 表示没有在等待
+    Snapshot pending;
+    long long period_bound = 0;
+
+    std::vector<Side> sides;
+
+    TMCycle cycle;
+
+    Snapshot take(int state, const std::vector<Tape> &tapes, long long step) const {
+        Snapshot snap;
+        snap.state = state;
+        snap.step = step;
+        size_t hash = std::hash<int>()(state);
+        for (int i = 0; i < tape_num; i++) {
+            int left = 0;
+            snap.cells.push_back(tapes[i].getNonBlank(left));
+            snap.lefts.push_back(left);
+            snap.heads.push_back(tapes[i].getHead());
+            hash = hash * 31 + std::hash<std::string>()(snap.cells.back());
+            hash = hash * 31 + static_cast<size_t>(snap.heads.back() - left);
+        }
+        snap.hash = hash;
+        return snap;
+    }
+
+    // 两个快照是否只差一个平移（每条纸带可以平移不同的距离）
+    bool sameUpToShift(const Snapshot &a, const Snapshot &b) const {
+        if (a.hash != b.hash || a.state != b.state) {
+            return false;
+        }
+        for (int i = 0; i < tape_num; i++) {
+            if (a.heads[i] - a.lefts[i] != b.heads[i] - b.lefts[i] || a.cells[i] != b.cells[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool found(long long step, long long length, int shift) {
+        cycle.length = length;
+        cycle.found_at = step;
+        cycle.shift = shift;
+        return true;
+    }
+
+    // 以 x 递增的顺序取出 [x - len + 1, x] 的内容
+    std::string window(const Side &side, const Tape &tape, int x, int len) const {
+        if (side.dir > 0) {
+            return tape.getCells(x - len + 1, len);
+        }
+        std::string content = tape.getCells(-x, len);
+        std::reverse(content.begin(), content.end());
+        return content;
+    }
+
+    bool checkSide(Side &side, int state, const Tape &tape, long long step) {
+        int x = side.dir * tape.getHead();
+        if (x <= side.record) {
+            side.back = std::min(side.back, x);
+            return false;
+        }
+
+        // 破纪录
+        side.lows.push_back(side.back);
+        side.record = x;
+        side.back = x;
+        if (x < side.bound) {
+            return false;
+        }
+
+        int j = static_cast<int>(side.lows.size()) - 1;
+        int i = side.last[state];
+        if (i >= 0 && j - i <= WINDOW) {
+            int x1 = side.last_x[state];
+            int low = x1;
+            for (int k = i + 1; k <= j; k++) {
+                low = std::min(low, side.lows[k]);
+            }
+            int len = x1 - low + 1;
+            if (len <= WINDOW) {
+                const std::string &before = side.last_window[state];
+                if (window(side, tape, x, len) == before.substr(before.size() - len)) {
+                    return found(step, step - side.last_step[state], side.dir * (x - x1));
+                }
+            }
+        }
+
+        side.last[state] = j;
+        side.last_step[state] = step;
+        side.last_x[state] = x;
+        side.last_window[state] = window(side, tape, x, WINDOW);
+        return false;
+    }
+
+public:
+
+    /**
+     * @param state_num The number of states of the program.
+     * @param tape_num The number of tapes.
+     * @param first, last Tape 0 is blank outside positions [first, last] when the run starts.
+     */
+    TMLoopDetector(int state_num, int tape_num, int first, int last) : tape_num(tape_num) {
+        if (tape_num != 1) {
+            return;
+        }
+        for (int dir : {1, -1}) {
+            Side side;
+            side.dir = dir;
+            // 一开始非空白的区间以外都是空白
+            side.bound = dir > 0 ? last : -first;
+            side.last.assign(state_num, -1);
+            side.last_step.assign(state_num, 0);
+            side.last_x.assign(state_num, 0);
+            side.last_window.assign(state_num, std::string());
+            sides.push_back(side);
+        }
+    }
+
+    /**
+     * Look at the configuration before a step.
+     *
+     * @return Whether the run is known to never halt; the cycle is then in getCycle().
+     */
+    bool check(int state, const std::vector<Tape> &tapes, long long step) {
+        for (auto &side : sides) {
+            if (checkSide(side, state, tapes[0], step)) {
+                return true;
+            }
+        }
+
+        if (period_bound != 0 && step > pending.step + period_bound) {
+            // 跳过扫描时可能错过确认的那一步，放弃这次重复，继续取快照
+            period_bound = 0;
+        }
+        if (period_bound != 0) {
+            // 最短的循环长度整除 period_bound
+            long long length = step - pending.step;
+            if (state == pending.state && length > 0 && period_bound % length == 0) {
+                Snapshot snap = take(state, tapes, step);
+                if (sameUpToShift(snap, pending)) {
+                    return found(step, length, snap.heads[0] - pending.heads[0]);
+                }
+            }
+            return false;
+        }
+
+        if (step < next_sample) {
+            return false;
+        }
+
+        Snapshot snap = take(state, tapes, step);
+        if (samples > 0 && sameUpToShift(snap, saved)) {
+            period_bound = step - saved.step;
+            pending = snap;
+            return false;
+        }
+
+        // 快照的代价与纸带长度成正比，纸带越长取得越稀疏
+        size_t size = 0;
+        for (const auto &cells : snap.cells) {
+            size += cells.size();
+        }
+        long long interval = static_cast<long long>(size) * 4;
+        next_sample = step + (interval > SAMPLE_INTERVAL ? interval : SAMPLE_INTERVAL);
+
+        if (++samples == power) {
+            saved = std::move(snap);
+            power *= 2;
+        }
+        return false;
+    }
+
+    const TMCycle& getCycle() const {
+        return cycle;
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * Tape backed by a reserved range of virtual memory.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_MAPPED_TAPE_H
+#define FLA_TM_MAPPED_TAPE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * A tape living in one large virtual address range reserved with mmap.
+ * 位置 0 放在保留区间的正中间，已提交（可读写）的区间 [lo, hi) 随读头移动按块向两侧扩展，
+ * 扩展时不需要搬移任何数据。保留但未提交的部分不可访问，起到保护页的作用。
+ * 已提交的总字节数超过 memory_limit 时抛出 ResourceLimitException，而不是耗尽主机内存。
+ *
+ * The tape owns its mapping, so it can be moved but not copied.
+ */
+class TMMappedTape {
+    char *base = nullptr;
+    size_t reserved = 0;
+
+    // 已提交的区间
+    char *lo = nullptr;
+    char *hi = nullptr;
+
+    char *cell = nullptr;
+    char *origin = nullptr;
+
+    char blank;
+
+    // 已提交字节数的上限，0 表示只受保留区间大小的限制
+    size_t memory_limit = 0;
+
+    // 每次提交的大小
+    static const size_t CHUNK = size_t(1) << 20;
+
+    // 未设置上限时，每侧保留的地址空间
+    static const size_t DEFAULT_RESERVE = size_t(1) << 35;
+
+    void reserve(size_t per_side);
+
+    void release();
+
+    void commit(char *from, char *to);
+
+    size_t chunkSize() const;
+
+    // 下一次扩展提交的字节数，不超过 memory_limit
+    size_t growthSize() const;
+
+    void growLeft();
+
+    void growRight();
+
+public:
+
+    explicit TMMappedTape(char blank_char);
+
+    TMMappedTape(TMMappedTape &&other) noexcept;
+
+    TMMappedTape& operator=(TMMappedTape &&other) noexcept;
+
+    TMMappedTape(const TMMappedTape &) = delete;
+
+    TMMappedTape& operator=(const TMMappedTape &) = delete;
+
+    ~TMMappedTape();
+
+    /**
+     * Init the tape with input string (symbol ids).
+     */
+    void init(const std::string &init_string);
+
+    /**
+     * Put content (symbol ids) at positions [left, left + content.size()) of a blank tape,
+     * with the head at position head. Used to resume a run from a snapshot.
+     */
+    void restore(const std::string &content, int left, int head);
+
+    inline char read() const {
+        return *cell;
+    }
+
+    inline void write(char x) {
+        *cell = x;
+    }
+
+    inline void moveLeft() {
+        if (cell == lo) {
+            growLeft();
+        }
+        --cell;
+    }
+
+    inline void moveRight() {
+        if (++cell == hi) {
+            growRight();
+        }
+    }
+
+    /**
+     * Move the head over the run of cells equal to the one under it, as repeated
+     * moveLeft()/moveRight() would do, stopping on the first different cell.
+     * 不会越过当前缓冲区的边界，也不会超过 max 步。
+     *
+     * @param dir -1 for left, 1 for right.
+     * @param max The maximum number of moves.
+     * @return The number of moves made.
+     */
+    size_t skipRun(int dir, size_t max);
+
+    /**
+     * Limit the committed memory of this tape. Must be called before init(),
+     * since the reserved range is sized from it.
+     *
+     * @param bytes The limit in bytes, 0 for no limit.
+     */
+    void setMemoryLimit(size_t bytes);
+
+    inline size_t getMemoryUsage() const {
+        return static_cast<size_t>(hi - lo);
+    }
+
+    inline int getHead() const {
+        return static_cast<int>(cell - origin);
+    }
+
+    inline char getBlank() const {
+        return blank;
+    }
+
+    std::string getAnswer() const;
+
+    std::string getNonBlank(int &idx) const;
+
+    /**
+     * Get the cells at positions [pos, pos + len) without moving the head or growing the tape.
+     * 缓冲区以外的格子为空白。
+     */
+    std::string getCells(int pos, int len) const;
+};
+
+#endif
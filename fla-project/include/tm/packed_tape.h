@@ -0,0 +1,251 @@
+/**
+ * Bit-packed tape for TMs with small tape alphabets.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_PACKED_TAPE_H
+#define FLA_TM_PACKED_TAPE_H
+
+#include "utils/exception.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A tape storing BITS bits per cell (BITS = 1, 2 or 4), packed into 64-bit words.
+ * 格子中存放的是 TMProgram 分配的符号编号，因此符号数不超过 2^BITS 时才能使用，
+ * 只有在输出和 verbose 时才需要解码成原始字符。
+ * 接口与 TMTape 相同，TMEmulator 可以用任意一种纸带运行。
+ */
+template <int BITS>
+class TMPackedTape {
+    static const int PER_WORD = 64 / BITS;
+    static const uint64_t MASK = (uint64_t(1) << BITS) - 1;
+    static const size_t MIN_WORDS = 4;
+
+    std::vector<uint64_t> words;
+
+    // 读头所在格子的下标，以及缓冲区的总格子数
+    size_t pos;
+    size_t size;
+
+    // 位置 0 的格子下标
+    long origin;
+
+    char blank;
+    uint64_t blank_word;
+
+    // 缓冲区大小上限（字节），0 表示不限制
+    size_t memory_limit = 0;
+
+    // 按当前字数翻倍，但不超过上限；已经到达上限时才报错
+    size_t growthFor(size_t current) const {
+        if (memory_limit == 0) {
+            return current;
+        }
+        size_t max_words = memory_limit / sizeof(uint64_t);
+        if (current >= max_words) {
+            throw ResourceLimitException("Tape memory limit exceeded: " + std::to_string(memory_limit) + " bytes");
+        }
+        return current < max_words - current ? current : max_words - current;
+    }
+
+    inline char cellAt(size_t i) const {
+        return static_cast<char>((words[i / PER_WORD] >> (i % PER_WORD * BITS)) & MASK);
+    }
+
+    void growLeft() {
+        size_t grow = growthFor(words.size());
+        words.insert(words.begin(), grow, blank_word);
+        pos += grow * PER_WORD;
+        origin += static_cast<long>(grow * PER_WORD);
+        size = words.size() * PER_WORD;
+    }
+
+    void growRight() {
+        words.resize(words.size() + growthFor(words.size()), blank_word);
+        size = words.size() * PER_WORD;
+    }
+
+public:
+
+    TMPackedTape() : TMPackedTape(0) {}
+
+    explicit TMPackedTape(char blank_char) : blank(blank_char) {
+        blank_word = 0;
+        for (int i = 0; i < PER_WORD; i++) {
+            blank_word |= (static_cast<uint64_t>(blank) & MASK) << (i * BITS);
+        }
+        init("");
+    }
+
+    /**
+     * Init the tape with input string (symbol ids).
+     */
+    void init(const std::string &init_string) {
+        // 两侧各留出至少 MIN_WORDS 个字的余量
+        size_t content_words = (init_string.size() + PER_WORD - 1) / PER_WORD;
+        size_t headroom = content_words / 2 > MIN_WORDS ? content_words / 2 : MIN_WORDS;
+        words.assign(content_words + 2 * headroom, blank_word);
+        size = words.size() * PER_WORD;
+        origin = static_cast<long>(headroom * PER_WORD);
+        pos = static_cast<size_t>(origin);
+        for (size_t i = 0; i < init_string.size(); i++) {
+            write(init_string[i]);
+            pos++;
+        }
+        pos = static_cast<size_t>(origin);
+    }
+
+    /**
+     * Put content (symbol ids) at positions [left, left + content.size()) of a blank tape,
+     * with the head at position head. Used to resume a run from a snapshot.
+     */
+    void restore(const std::string &content, int left, int head) {
+        init(content);
+        origin -= left;
+        pos = static_cast<size_t>(origin + head);
+    }
+
+    inline char read() const {
+        return cellAt(pos);
+    }
+
+    inline void write(char x) {
+        uint64_t &word = words[pos / PER_WORD];
+        int shift = pos % PER_WORD * BITS;
+        word = (word & ~(MASK << shift)) | (static_cast<uint64_t>(x) & MASK) << shift;
+    }
+
+    inline void moveLeft() {
+        if (pos == 0) {
+            growLeft();
+        }
+        --pos;
+    }
+
+    inline void moveRight() {
+        if (++pos == size) {
+            growRight();
+        }
+    }
+
+    /**
+     * Move the head over the run of cells equal to the one under it, as repeated
+     * moveLeft()/moveRight() would do, stopping on the first different cell.
+     * 不会越过当前缓冲区的边界，也不会超过 max 步。
+     *
+     * @param dir -1 for left, 1 for right.
+     * @param max The maximum number of moves.
+     * @return The number of moves made.
+     */
+    size_t skipRun(int dir, size_t max) {
+        char ch = read();
+        uint64_t pattern = 0;
+        for (int i = 0; i < PER_WORD; i++) {
+            pattern |= (static_cast<uint64_t>(ch) & MASK) << (i * BITS);
+        }
+
+        size_t len = dir > 0 ? std::min(size - 1 - pos, max) : std::min(pos, max);
+        size_t n = 0;
+        while (n < len) {
+            size_t i = dir > 0 ? pos + 1 + n : pos - 1 - n;
+            // 对齐到字边界时，整个字相同则一次跳过
+            if (i % PER_WORD == (dir > 0 ? 0 : PER_WORD - 1) && n + PER_WORD <= len &&
+                words[i / PER_WORD] == pattern) {
+                n += PER_WORD;
+                continue;
+            }
+            if (cellAt(i) != ch) {
+                break;
+            }
+            n++;
+        }
+        n = n < len ? n + 1 : n;
+        pos = dir > 0 ? pos + n : pos - n;
+        return n;
+    }
+
+    inline int getHead() const {
+        return static_cast<int>(static_cast<long>(pos) - origin);
+    }
+
+    inline void setMemoryLimit(size_t bytes) {
+        memory_limit = bytes;
+    }
+
+    inline size_t getMemoryUsage() const {
+        return words.size() * sizeof(uint64_t);
+    }
+
+    inline char getBlank() const {
+        return blank;
+    }
+
+    std::string getAnswer() const {
+        // 整个字都是空白时直接跳过
+        size_t first = 0;
+        while (first < size && words[first / PER_WORD] == blank_word) {
+            first += PER_WORD;
+        }
+        while (first < size && cellAt(first) == blank) {
+            first++;
+        }
+        if (first == size) {
+            return std::string();
+        }
+
+        size_t last = size - 1;
+        while (words[last / PER_WORD] == blank_word) {
+            last = last / PER_WORD * PER_WORD - 1;
+        }
+        while (cellAt(last) == blank) {
+            last--;
+        }
+
+        std::string content(last - first + 1, blank);
+        for (size_t i = first; i <= last; i++) {
+            content[i - first] = cellAt(i);
+        }
+        return content;
+    }
+
+    std::string getNonBlank(int &idx) const {
+        // 最左、最右的非空白格子，但不越过读头
+        size_t left = 0;
+        while (left < pos && cellAt(left) == blank) {
+            left++;
+        }
+        size_t right = size - 1;
+        while (right > pos && cellAt(right) == blank) {
+            right--;
+        }
+
+        idx = static_cast<int>(static_cast<long>(left) - origin);
+
+        std::string content(right - left + 1, blank);
+        for (size_t i = left; i <= right; i++) {
+            content[i - left] = cellAt(i);
+        }
+        return content;
+    }
+
+    /**
+     * Get the cells at positions [pos, pos + len) without moving the head or growing the tape.
+     * 缓冲区以外的格子为空白。
+     */
+    std::string getCells(int pos, int len) const {
+        std::string content(len, blank);
+        for (int i = 0; i < len; i++) {
+            long idx = static_cast<long>(pos) + i + origin;
+            if (idx >= 0 && static_cast<size_t>(idx) < size) {
+                content[i] = cellAt(static_cast<size_t>(idx));
+            }
+        }
+        return content;
+    }
+};
+
+#endif
@@ -9,30 +9,35 @@
 
 #include "tm/context.h"
 #include <string>
-#include <regex>
 #include "utils/exception.h"
+#include "utils/parse_token.h"
 
 class TMParser {
 
-    static void parseLine(const std::string& line, TMContext& context);
+    static void parseLine(const LineTokenizer& tokenizer, TMContext& context);
 
-    static void linePreprocess(std::string &line);
-
-    static std::set<std::string> control_tokens;
-
-    static std::regex state_regex;
+    static bool isControlToken(StringView token);
 
     static bool isValidSymbol(char c);
 
+
 public:
 
     /**
-     * Parse a TM configuration file.
+     * Parse a TM configuration file. The file is mapped into memory and tokenized in place.
      * 
      * @param filepath The filepath of the configuration file.
      * @return The TM context parsed from the file.
      */
     static TMContext parse(const std::string &filepath);
+
+    /**
+     * Parse the content of a TM configuration file.
+     *
+     * @param content The text of the configuration file.
+     * @return The TM context parsed from it.
+     */
+    static TMContext parseContent(StringView content);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+/**
+ * Compiled form of a TM, used by TMEmulator at run time.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_PROGRAM_H
+#define FLA_TM_PROGRAM_H
+
+#include "tm/context.h"
+#include "utils/string_view.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A TMContext compiled into integer form.
+ *
+ * 状态和纸带符号都被编号为从 0 开始的小整数（按 std::set 的顺序，因此编号是稳定的），
+ * 转移函数被展开为一张以 (状态编号, 各纸带符号编号组成的元组) 为下标的稠密表，
+ * 表项为转移编号，-1 表示没有可用的转移。多个转移匹配时按 TMDeltaMap 的优先级规则选出唯一一个，
+ * 因此运行时不再需要匹配通配符。只有从初始状态可达的非终止状态会被展开。
+ *
+ * 纸带上存放的是符号编号而不是原始字符，只在输出时才解码。
+ *
+ * Should be created with TMProgram::compile() from a validated TMContext.
+ */
+class TMProgram {
+public:
+    // 替换符号为 '*' 时，写入 KEEP，表示保留原内容
+    static const uint8_t KEEP = 0xFF;
+
+    // 稠密表的最大表项数，超过后退化为逐步查询 TMDeltaMap
+    static const size_t MAX_DENSE_ENTRIES = 1 << 22;
+
+    // .tmc 文件的格式版本。compile() 的结果改变时也要增加，使旧的预编译文件和缓存失效
+    static const uint32_t FILE_VERSION = 3;
+
+private:
+    int tape_num = 0;
+    int symbol_num = 0;
+    int start_state = 0;
+    uint8_t blank = 0;
+
+    std::vector<std::string> state_names;
+    std::vector<char> final_flags;              // indexed by state id
+
+    std::vector<char> symbols;                  // symbol id -> char
+    int16_t encode_map[256];                    // char -> symbol id, -1 if not in tape alphabet
+    char input_flags[256];                      // char -> whether in input alphabet
+
+    int transition_num = 0;
+    size_t tuple_num = 0;                       // symbol_num ^ tape_num
+
+    // 下面的大数组存放在 storage 中：compile() 时为 vector，load() 时直接指向映射的 .tmc 文件。
+    // 复制 TMProgram 时共享同一份 storage。
+    std::shared_ptr<const void> storage;
+
+    // 转移 t 的内容：next_states[t]，writes[t * tape_num + i]，moves[t * tape_num + i]
+    const int32_t *next_states = nullptr;
+    const uint8_t *writes = nullptr;
+    const int8_t *moves = nullptr;
+
+    // 转移 t 在源文件中的源状态 sources[t] 和旧符号组 patterns[t * tape_num + i]（可能含 '*'），
+    // 只用于性能分析的报告
+    const int32_t *sources = nullptr;
+    const char *patterns = nullptr;
+
+    const int32_t *table = nullptr;             // state * tuple_num + tuple -> transition id
+
+    // 与 table 对应：若该表项是在一条纸带上扫过连续相同符号的自环（只移动这一条纸带，且不改变任何纸带内容），
+    // 则为 ±(纸带下标 + 1)，符号表示移动方向；否则为 0
+    const int8_t *sweeps = nullptr;
+
+    // 稠密表过大时使用的后备查询
+    bool dense = false;
+    TMDeltaMap fallback;
+
+    // 机器内容的指纹，见 getHash()
+    uint64_t hash = 0;
+
+    // 与程序一起保存的源文件内容，指向映射的文件，见 getSource()
+    StringView source;
+
+    int32_t lookupFallback(int state, const char *syms) const;
+
+    int8_t sweepOf(int state, int32_t transition, const std::string &input_chars) const;
+
+public:
+
+    /**
+     * Compile a TM context. The context must be valid.
+     *
+     * @param context The TM context.
+     * @return The compiled program.
+     */
+    static TMProgram compile(const TMContext &context);
+
+    /**
+     * Write the program to a precompiled .tmc file, see src/tm/program_file.cpp for the layout.
+     * The file is written next to the target and renamed over it.
+     *
+     * @param source_text The machine file the program was compiled from, stored so that a
+     *                    cache hit can be confirmed with getSource(); may be empty.
+     * @throws std::runtime_error if the program is not dense or the file cannot be written.
+     */
+    void save(const std::string &path, StringView source_text = StringView()) const;
+
+    /**
+     * Load a program written by save(). 文件被映射到内存中直接使用，检查文件头、各部分的大小和
+     * 每一项的取值范围，不解析转移，也不为转移分配内存。
+     *
+     * @throws std::runtime_error if the file cannot be read or is not a valid .tmc file
+     *         of this version.
+     */
+    static std::shared_ptr<const TMProgram> load(const std::string &path);
+
+    /**
+     * Find the transition for a state and the symbols currently under each head.
+     *
+     * @param state The current state id.
+     * @param syms The symbol ids under each head, tape_num of them.
+     * @return The transition id, -1 if no transition applies.
+     */
+    inline int32_t lookup(int state, const char *syms) const {
+        if (!dense) {
+            return lookupFallback(state, syms);
+        }
+        size_t tuple = 0;
+        for (int i = 0; i < tape_num; i++) {
+            tuple = tuple * symbol_num + static_cast<uint8_t>(syms[i]);
+        }
+        return table[state * tuple_num + tuple];
+    }
+
+    /**
+     * Same as lookup, also reporting whether the transition is a sweep.
+     *
+     * @param sweep Set to ±(tape + 1) if the transition is a self loop that only moves
+     *              that tape in the direction of the sign and writes nothing new, 0 otherwise.
+     */
+    inline int32_t lookup(int state, const char *syms, int8_t &sweep) const {
+        if (!dense) {
+            sweep = 0;
+            return lookupFallback(state, syms);
+        }
+        size_t tuple = 0;
+        for (int i = 0; i < tape_num; i++) {
+            tuple = tuple * symbol_num + static_cast<uint8_t>(syms[i]);
+        }
+        size_t entry = state * tuple_num + tuple;
+        sweep = sweeps[entry];
+        return table[entry];
+    }
+
+    inline int getTapeNum() const {
+        return tape_num;
+    }
+
+    inline int getSymbolNum() const {
+        return symbol_num;
+    }
+
+    inline int getStateNum() const {
+        return static_cast<int>(state_names.size());
+    }
+
+    inline int getTransitionNum() const {
+        return transition_num;
+    }
+
+    inline int getStartState() const {
+        return start_state;
+    }
+
+    inline char getBlank() const {
+        return static_cast<char>(blank);
+    }
+
+    inline bool isFinal(int state) const {
+        return final_flags[state];
+    }
+
+    /**
+     * @return The number of bits needed to store a symbol id: 1, 2, 4 or 8.
+     */
+    inline int getCellBits() const {
+        return symbol_num <= 2 ? 1 : symbol_num <= 4 ? 2 : symbol_num <= 16 ? 4 : 8;
+    }
+
+    inline bool isDense() const {
+        return dense;
+    }
+
+    /**
+     * @return A 64-bit FNV-1a hash of the machine: alphabets, states and transitions in file order.
+     * Two programs with the same hash run the same way on the same tapes.
+     */
+    inline uint64_t getHash() const {
+        return hash;
+    }
+
+    /**
+     * @return The source text stored by save() in the file this program was loaded from,
+     *         empty if there is none.
+     */
+    inline StringView getSource() const {
+        return source;
+    }
+
+    inline bool isInputSymbol(char ch) const {
+        return input_flags[static_cast<uint8_t>(ch)];
+    }
+
+    inline const std::string& getStateName(int state) const {
+        return state_names[state];
+    }
+
+    inline int getNextState(int32_t transition) const {
+        return next_states[transition];
+    }
+
+    inline const uint8_t* getWrites(int32_t transition) const {
+        return &writes[transition * tape_num];
+    }
+
+    inline const int8_t* getMoves(int32_t transition) const {
+        return &moves[transition * tape_num];
+    }
+
+    inline int getSource(int32_t transition) const {
+        return sources[transition];
+    }
+
+    /**
+     * @return Whether the transition matches some tape with the wildcard '*'.
+     */
+    bool isWildcard(int32_t transition) const;
+
+    /**
+     * @return The transition as written in the source file, e.g. "q0 1_ 1_ rr q1".
+     */
+    std::string describeTransition(int32_t transition) const;
+
+    inline char decodeSymbol(char id) const {
+        return symbols[static_cast<uint8_t>(id)];
+    }
+
+    /**
+     * Encode a string of tape symbols into symbol ids.
+     * All the characters must be in the tape alphabet.
+     */
+    std::string encode(const std::string &str) const;
+
+    /**
+     * Decode a string of symbol ids into tape symbols.
+     */
+    std::string decode(const std::string &ids) const;
+};
+
+#endif
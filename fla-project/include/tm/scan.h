@@ -0,0 +1,56 @@
+/**
+ * Helpers to scan runs of equal cells on byte tapes.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_SCAN_H
+#define FLA_TM_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Count how many cells starting at from (going right) are equal to ch, looking at no more than len cells.
+ * 一次比较 8 个字节，找到第一个不同的字节后再逐个比较。
+ */
+inline size_t countRunForward(const char *from, size_t len, char ch) {
+    const uint64_t pattern = 0x0101010101010101ULL * static_cast<uint8_t>(ch);
+    size_t n = 0;
+    while (n + 8 <= len) {
+        uint64_t word;
+        std::memcpy(&word, from + n, 8);
+        if (word != pattern) {
+            break;
+        }
+        n += 8;
+    }
+    while (n < len && from[n] == ch) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Count how many cells ending at from (going left, from included) are equal to ch,
+ * looking at no more than len cells.
+ */
+inline size_t countRunBackward(const char *from, size_t len, char ch) {
+    const uint64_t pattern = 0x0101010101010101ULL * static_cast<uint8_t>(ch);
+    size_t n = 0;
+    while (n + 8 <= len) {
+        uint64_t word;
+        std::memcpy(&word, from - n - 7, 8);
+        if (word != pattern) {
+            break;
+        }
+        n += 8;
+    }
+    while (n < len && *(from - n) == ch) {
+        n++;
+    }
+    return n;
+}
+
+#endif
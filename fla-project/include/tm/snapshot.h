@@ -0,0 +1,69 @@
+/**
+ * Binary snapshot of a running TM, used to checkpoint and resume long runs.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_SNAPSHOT_H
+#define FLA_TM_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The configuration of a TM run between two steps.
+ *
+ * 文件格式（整数均为小端序）：
+ *   "FLATMSNP"  8 字节魔数
+ *   u32         格式版本，当前为 1
+ *   u64         机器指纹 TMProgram::getHash()
+ *   i32         当前状态编号
+ *   i64         已运行的步数
+ *   u32         纸带数
+ *   每条纸带：i32 内容最左格子的位置，i32 读头位置，u64 内容长度，内容（符号编号，每格一个字节）
+ *
+ * 纸带内容只保存非空白的部分（以及读头所在的格子），与纸带的存储方式无关。
+ */
+struct TMSnapshot {
+    struct TapeImage {
+        int left = 0;
+        int head = 0;
+        std::string cells;
+    };
+
+    uint64_t machine_hash = 0;
+    int state = 0;
+    long long steps = 0;
+    std::vector<TapeImage> tapes;
+
+    /**
+     * @return The snapshot in the file format described above.
+     */
+    std::string toBytes() const;
+
+    /**
+     * Read a snapshot from the bytes written by toBytes().
+     *
+     * @param name The file name used in error messages.
+     * @throws std::runtime_error if data is not a valid snapshot.
+     */
+    static TMSnapshot fromBytes(const std::string &data, const std::string &name);
+
+    /**
+     * Write the snapshot to a file. The file is written next to the target and renamed
+     * over it, so an interrupted save never leaves a truncated snapshot behind.
+     *
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string &path) const;
+
+    /**
+     * Read a snapshot written by save().
+     *
+     * @throws std::runtime_error if the file cannot be read or is not a valid snapshot.
+     */
+    static TMSnapshot load(const std::string &path);
+};
+
+#endif
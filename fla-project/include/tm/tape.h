@@ -1,67 +1,164 @@
 /**
  * Define the tape structure and the tape functions.
- * 
+ *
  * Author: Wenze Jin
  */
 
 #ifndef FLA_TM_TAPE_H
 #define FLA_TM_TAPE_H
 
-#include <deque>
 #include <string>
+#include <vector>
 
+/**
+ * A tape backed by one contiguous buffer.
+ * 缓冲区两侧都预留空白的余量，读头走出缓冲区时向该方向按倍数扩容，
+ * 因此读写和移动读头都只是指针操作。余量部分总是空白符。
+ */
 class TMTape {
-    std::deque<char> tape;
+    std::vector<char> buffer;
+
+    // 读头所在的格子
+    char *cell;
+
+    // 位置 0 在 buffer 中的下标
+    int origin;
 
-    int left_idx;
-    int head;
-    
     // character for blank spaces
     char blank;
 
+    // 缓冲区大小上限（字节），0 表示不限制
+    size_t memory_limit = 0;
+
+    static const int MIN_HEADROOM = 32;
+
+    /**
+     * @return How many cells to add to a buffer of the given size: as many again, but no
+     *         more than the memory limit allows.
+     * @throws ResourceLimitException if the buffer is already at the limit.
+     */
+    size_t growthFor(size_t size) const;
+
+    void growLeft();
+
+    void growRight();
+
+    void reset(const std::string &content, int head_offset);
+
 public:
-    
+
     TMTape();
 
     TMTape(char blank_char);
 
+    TMTape(const TMTape &other);
+
+    TMTape& operator=(const TMTape &other);
+
     /**
      * Init the tape with input string.
-     * @param init_string The initial input string. 
+     * @param init_string The initial input string.
      */
     void init(std::string init_string);
 
-    char read() const;
+    /**
+     * Put content (symbol ids) at positions [left, left + content.size()) of a blank tape,
+     * with the head at position head. Used to resume a run from a snapshot.
+     */
+    void restore(const std::string &content, int left, int head);
 
-    void write(char x);
+    inline char read() const {
+        return *cell;
+    }
 
-    void moveLeft();
+    inline void write(char x) {
+        *cell = x;
+    }
 
-    void moveRight();
+    inline void moveLeft() {
+        if (cell == buffer.data()) {
+            growLeft();
+        }
+        --cell;
+    }
+
+    inline void moveRight() {
+        if (++cell == buffer.data() + buffer.size()) {
+            growRight();
+        }
+    }
 
     void clear();
 
     /**
-     * This function will minimize the deque, by removing useless blank characters around.
+     * Move the head over the run of cells equal to the one under it, as repeated
+     * moveLeft()/moveRight() would do, stopping on the first different cell.
+     * 不会越过当前缓冲区的边界，也不会超过 max 步。
+     *
+     * @param dir -1 for left, 1 for right.
+     * @param max The maximum number of moves.
+     * @return The number of moves made.
+     */
+    size_t skipRun(int dir, size_t max);
+
+    /**
+     * Get the cells at positions [pos, pos + len), growing the buffer if needed.
+     * The pointer is valid until the tape grows again.
+     */
+    char* cellsAt(int pos, int len);
+
+    /**
+     * Move the head to a position, growing the buffer if needed.
+     */
+    void seek(int pos);
+
+    /**
+     * Limit the size of the buffer. Growing beyond it throws ResourceLimitException.
+     *
+     * @param bytes The limit in bytes, 0 for no limit.
+     */
+    inline void setMemoryLimit(size_t bytes) {
+        memory_limit = bytes;
+    }
+
+    inline size_t getMemoryUsage() const {
+        return buffer.size();
+    }
+
+    /**
+     * This function will minimize the buffer, by removing useless blank characters around.
      */
     void minimize();
 
 
+    /**
+     * @return The position of the first cell in the buffer.
+     */
     inline int getLeftIdx() const {
-        return left_idx;
+        return -origin;
     }
 
     inline int getHead() const {
-        return head;
+        return static_cast<int>(cell - buffer.data()) - origin;
     }
 
-    inline const std::deque<char>& getTape() const {
-        return tape;
+    inline const std::vector<char>& getTape() const {
+        return buffer;
+    }
+
+    inline char getBlank() const {
+        return blank;
     }
 
     std::string getAnswer() const;
 
     std::string getNonBlank(int &idx) const;
+
+    /**
+     * Get the cells at positions [pos, pos + len) without moving the head or growing the tape.
+     * 缓冲区以外的格子为空白。
+     */
+    std::string getCells(int pos, int len) const;
 };
 
-#endif
\ No newline at end of file
+#endif
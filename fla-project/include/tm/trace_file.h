@@ -0,0 +1,199 @@
+/**
+ * Binary execution traces of TM runs, recorded while running and rendered offline.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_TRACE_FILE_H
+#define FLA_TM_TRACE_FILE_H
+
+#include "tm/program.h"
+#include "tm/snapshot.h"
+#include "tm/tape.h"
+#include "tm/trace_writer.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Writes the trace of one run.
+ *
+ * 文件格式：
+ *   "FLATMTRC"  8 字节魔数
+ *   u32         格式版本，当前为 1（小端序，下同）
+ *   u64         起始格局的长度 n
+ *   n 字节      运行开始时的格局，格式与快照文件相同（含机器指纹）
+ *   之后每一步一条记录：该步使用的转移编号，按 LEB128 变长编码
+ *
+ * 每一步写入的符号和读头的移动由转移唯一确定，回放时从机器中取得，不再重复记录，
+ * 因此多数机器每步只占 1 到 2 个字节。文件没有结尾标记，运行被中途杀死时已写出的部分仍可回放。
+ *
+ * 关键帧（完整的格局）写在旁边的 path + ".keys" 文件中，回放时从最近的关键帧开始，不必从头重放：
+ *   "FLATMKEY"  8 字节魔数
+ *   u32         格式版本，当前为 1
+ *   u64         轨迹文件中起始格局的 FNV-1a 指纹，用于确认两个文件属于同一次运行
+ *   之后每个关键帧：i64 步数，u64 该步的记录在轨迹文件中的偏移，u64 格局的长度 n，n 字节格局（快照格式）
+ */
+class TMTraceRecorder {
+    static const size_t FLUSH_SIZE = 1 << 16;
+
+    std::string path;
+    std::ofstream file;
+    std::string buffer;
+
+    // 已经写入轨迹文件的字节数
+    uint64_t written = 0;
+
+    // 关键帧文件，不记录关键帧时不打开
+    std::ofstream keys;
+
+    void writeBuffer();
+
+public:
+
+    /**
+     * @return The keyframe file next to the trace at path.
+     */
+    static std::string keyframePath(const std::string &path);
+
+    /**
+     * Create the trace file and write the header.
+     *
+     * @param start The configuration the run starts from.
+     * @param keyframes Whether keyframe() will be called. If not, a stale keyframe file is removed.
+     * @throws std::runtime_error if the files cannot be written.
+     */
+    TMTraceRecorder(const std::string &path, const TMSnapshot &start, bool keyframes);
+
+    TMTraceRecorder(const TMTraceRecorder &) = delete;
+    TMTraceRecorder &operator=(const TMTraceRecorder &) = delete;
+
+    ~TMTraceRecorder();
+
+    /**
+     * Record that the next step uses transition.
+     */
+    inline void step(int32_t transition) {
+        uint32_t value = static_cast<uint32_t>(transition);
+        while (value >= 0x80) {
+            buffer += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        buffer += static_cast<char>(value);
+        if (buffer.size() >= FLUSH_SIZE) {
+            writeBuffer();
+        }
+    }
+
+    /**
+     * Save the configuration before the next step as a keyframe.
+     *
+     * @throws std::runtime_error if the keyframe file cannot be written.
+     */
+    void keyframe(const TMSnapshot &snapshot);
+
+    /**
+     * Write everything recorded so far to the file.
+     *
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void close();
+};
+
+/**
+ * Replays a trace written by TMTraceRecorder on the machine that recorded it,
+ * forward step by step or by seeking to any step.
+ */
+class TMTraceReplay {
+    // 可以开始回放的位置：起始格局或一个关键帧
+    struct Keyframe {
+        long long step;
+        uint64_t offset;        // 该步的记录在轨迹文件中的偏移
+        uint64_t image_offset;  // 格局在关键帧文件中的偏移，起始格局为 0
+        uint64_t image_size;
+    };
+
+    std::shared_ptr<const TMProgram> program;
+    std::string path;
+    std::ifstream file;
+
+    // 起始格局，以及按步数排列的关键帧（第一个是起始格局）
+    TMSnapshot start;
+    std::vector<Keyframe> keyframes;
+    std::ifstream keys;
+
+    // 读入的记录，每次读一整块
+    std::vector<char> chunk;
+    size_t chunk_pos = 0;
+    size_t chunk_len = 0;
+
+    int state;
+    long long step_cnt;
+    std::vector<TMTape> tapes;
+
+    // 当前各纸带读头下的符号编号，用来检查每条记录的转移
+    std::vector<char> syms;
+
+    // 渲染纸带时复用的缓冲区
+    std::string cells;
+
+    bool readByte(uint8_t &byte);
+
+    /**
+     * Read the keyframe index, keeping the keyframes that belong to this trace.
+     */
+    void loadKeyframes(uint64_t trace_id, uint64_t trace_size);
+
+    /**
+     * Continue from a keyframe.
+     */
+    void restore(const Keyframe &keyframe);
+
+public:
+
+    /**
+     * Open a trace, with its keyframe file if there is one, and set up the configuration
+     * it starts from.
+     *
+     * @throws std::runtime_error if the file is not a trace, or was recorded on another machine.
+     */
+    TMTraceReplay(const std::string &path, std::shared_ptr<const TMProgram> program);
+
+    inline long long getStep() const {
+        return step_cnt;
+    }
+
+    inline int getState() const {
+        return state;
+    }
+
+    /**
+     * Apply the next recorded step.
+     *
+     * @return false if the trace has no more steps.
+     * @throws std::runtime_error if the record is not a transition of the machine.
+     */
+    bool step();
+
+    /**
+     * Move to a step, from the nearest keyframe at or before it if that is closer
+     * than the current step. Steps before the start of the trace go to its start.
+     *
+     * @return false if the trace ends before the step, leaving the replay at its end.
+     */
+    bool seek(long long target);
+
+    /**
+     * Go back n steps (to the start of the trace at most).
+     */
+    void back(long long n);
+
+    /**
+     * Write the current configuration in the format of verbose mode.
+     */
+    void render(TMTraceWriter &writer);
+};
+
+#endif
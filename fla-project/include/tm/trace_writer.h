@@ -0,0 +1,80 @@
+/**
+ * Text rendering of TM configurations for verbose mode.
+ *
+ * Author: Wenze Jin
+ */
+
+#ifndef FLA_TM_TRACE_WRITER_H
+#define FLA_TM_TRACE_WRITER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/**
+ * Writes verbose output (Step / State / Index / Tape / Head blocks and plain lines)
+ * into one reusable buffer, which goes to the stream in large blocks.
+ *
+ * 格式与逐行输出时完全相同，只是不再每行刷新；需要与其他输出保持先后顺序时调用 flush()。
+ */
+class TMTraceWriter {
+    static const size_t FLUSH_SIZE = 1 << 16;
+
+    std::ostream &out;
+    std::string buffer;
+
+    // 一条纸带的三行，复用以避免每步分配
+    std::string index_line;
+    std::string tape_line;
+    std::string head_line;
+
+    inline void flushIfFull() {
+        if (buffer.size() >= FLUSH_SIZE) {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+public:
+
+    explicit TMTraceWriter(std::ostream &out) : out(out) {}
+
+    TMTraceWriter(const TMTraceWriter &) = delete;
+    TMTraceWriter &operator=(const TMTraceWriter &) = delete;
+
+    ~TMTraceWriter() {
+        flush();
+    }
+
+    /**
+     * Write a line, without the trailing newline.
+     */
+    void line(const std::string &message);
+
+    /**
+     * Start a configuration with its Step and State lines.
+     */
+    void beginConfiguration(long long step, const std::string &state);
+
+    /**
+     * Write the Index, Tape and Head lines of tape i.
+     *
+     * @param cells The tape symbols to show, starting at position left.
+     * @param len The number of cells.
+     * @param left The position of the first cell.
+     * @param head The position of the head, marked with '^' if it is among the cells.
+     */
+    void tape(int i, const char *cells, size_t len, int left, int head);
+
+    /**
+     * End a configuration with the separator line.
+     */
+    void endConfiguration();
+
+    /**
+     * Write everything buffered to the stream and flush it.
+     */
+    void flush();
+};
+
+#endif
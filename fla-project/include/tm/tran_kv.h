@@ -7,6 +7,7 @@
 #ifndef FLA_TM_TRAN_KV_H
 #define FLA_TM_TRAN_KV_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -44,6 +45,7 @@ struct TMTransitionValue {
     std::string next_state;   // next state
     std::string replace_chars;
     std::vector<TapeDirection> tape_directions;
+    int id;                   // order of insertion, assigned by TMDeltaMap
 
     TMTransitionValue(std::string next_state, std::string replace_chars, const std::vector<TapeDirection>& tape_directions);
 };
@@ -63,20 +65,72 @@ struct TMQueryResult {
 
 using TranMap = std::unordered_map<TMTransitionKey, TMTransitionValue, TMTransitionKeyHash>;
 
+/**
+ * Index over the wildcard input patterns of a single state.
+ * 每个带通配符的模式占一个比特位（按插入顺序）。对第 i 条纸带维护位图：
+ * star_masks[i] 表示第 i 位为 '*' 的模式，char_masks[i][c] 表示第 i 位为 c 的模式。
+ * 查询时将各纸带的位图按位与，最低的置位即为命中的模式，
+ * 代价只与纸带数（以及模式数 / 64）有关。
+ */
+class TMWildcardIndex {
+    std::vector<std::string> patterns;
+
+    std::vector<std::vector<uint64_t>> star_masks;
+    std::vector<std::unordered_map<char, std::vector<uint64_t>>> char_masks;
+
+public:
+
+    void insert(const std::string &pattern);
+
+    /**
+     * Find the first inserted pattern matching input_chars.
+     *
+     * @return The matched pattern, nullptr if nothing matches.
+     */
+    const std::string* match(const std::string &input_chars) const;
+};
+
 /**
  * Map for TM transitions.
  * 对 unordered_map 进行包装，使其在存储时，将不同的 key 分开存储，
  * 但是在查询时，考虑通配符‘*’的影响。
+ *
+ * 多个转移同时匹配时的优先级：
+ * 1. 不含通配符的转移优先；
+ * 2. 通配符个数越少（越具体）越优先；
+ * 3. 通配符个数相同时，先声明的优先。
  */
 class TMDeltaMap {
     TranMap _map;
 
+    // 每个状态下带通配符的转移的索引，按通配符个数分组，下标为通配符个数
+    std::unordered_map<std::string, std::vector<TMWildcardIndex>> _wildcards;
+
 public:
     
-    void insert(const TMTransitionKey &key, const TMTransitionValue &value);
+    void insert(TMTransitionKey key, TMTransitionValue value);
 
     TMQueryResult query(const TMTransitionKey &key) const;
 
+    /**
+     * Same as query, but returns the stored value directly.
+     *
+     * @return The matched value, nullptr if no transition matches.
+     */
+    const TMTransitionValue* find(const TMTransitionKey &key) const;
+
+    inline size_t size() const {
+        return _map.size();
+    }
+
+    /**
+     * Find pairs of wildcard transitions of the same state that can match the same input
+     * and are only told apart by declaration order.
+     *
+     * @return One human readable description per ambiguous pair.
+     */
+    std::vector<std::string> findAmbiguousOverlaps() const;
+
     inline const TranMap& getMap() const {
         return _map;
     }
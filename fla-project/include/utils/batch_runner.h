@@ -0,0 +1,47 @@
+/**
+ * Run many inputs through one automaton on a pool of worker threads.
+ */
+
+#ifndef FLA_UTILS_BATCH_RUNNER_H
+#define FLA_UTILS_BATCH_RUNNER_H
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+
+/**
+ * Reads inputs line by line, runs them on worker threads and writes one result line
+ * per input, in input order.
+ *
+ * 输入按 CHUNK 行分块，工作线程每次取一整块处理，减少同步的开销；
+ * 主线程负责读入和按顺序写出，同时在处理中的块不超过线程数的两倍，因此内存占用与输入总量无关。
+ */
+class BatchRunner {
+public:
+    // 运行一个输入，返回要输出的一行（不含换行符）
+    using Job = std::function<std::string(const std::string &input)>;
+
+    // 每个工作线程调用一次，得到只属于该线程的 Job（例如持有自己的模拟器）
+    using JobFactory = std::function<Job()>;
+
+private:
+    static const size_t CHUNK = 1024;
+
+    int threads;
+
+public:
+
+    /**
+     * @param threads The number of worker threads, at least 1.
+     */
+    explicit BatchRunner(int threads);
+
+    /**
+     * Run every line of in, and write the results to out.
+     * 行尾的 '\r' 会被去掉。Job 抛出的异常会在写到对应的行时重新抛出。
+     */
+    void run(std::istream &in, std::ostream &out, const JobFactory &factory);
+};
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * Directory of precompiled machines shared by all runs of fla.
+ */
+
+#ifndef FLA_UTILS_DISK_CACHE_H
+#define FLA_UTILS_DISK_CACHE_H
+
+#include "utils/string_view.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * Maps the text of a machine file to the path of its precompiled form.
+ *
+ * 缓存项的文件名是源文件内容与格式版本的哈希，因此文件被修改或 fla 升级后自然不会命中旧的缓存项。
+ * 文件名只是索引：缓存项中保存了完整的源文件内容，调用方加载后必须与源文件比较，
+ * 不一致（哈希碰撞或文件被改动）或加载失败时删除该项并重新解析。
+ * 缓存项由写入方先写临时文件再改名，读到的总是完整的文件。命中时更新缓存项的修改时间，
+ * 写入新的缓存项后按修改时间从旧到新删除文件，使目录的总大小不超过上限。
+ * 缓存只是加速手段：目录无法创建或写入时，调用方应当照常解析。
+ */
+class DiskCache {
+    std::string dir;
+    uint64_t max_bytes;
+
+public:
+
+    // 缓存目录的默认大小上限
+    static const uint64_t DEFAULT_MAX_BYTES = uint64_t(256) << 20;
+
+    /**
+     * @param dir The cache directory, created on first use. Empty disables the cache.
+     * @param max_bytes The total size of the entries kept by evict().
+     */
+    explicit DiskCache(std::string dir, uint64_t max_bytes = DEFAULT_MAX_BYTES);
+
+    /**
+     * @return $XDG_CACHE_HOME/fla, or $HOME/.cache/fla if XDG_CACHE_HOME is not set,
+     *         or an empty string if neither is set.
+     */
+    static std::string defaultDirectory();
+
+    /**
+     * Get the path of the cache entry for a machine file.
+     *
+     * @param content The text of the machine file.
+     * @param version The format version of the precompiled file.
+     * @param extension The extension of the precompiled file, such as "tmc".
+     * @return The path, which may not exist yet; empty if the cache is disabled or
+     *         the directory cannot be created.
+     */
+    std::string entryPath(StringView content, uint32_t version, const std::string &extension) const;
+
+    /**
+     * Mark an entry as used, so that evict() removes it later than the others.
+     */
+    void touch(const std::string &entry) const;
+
+    /**
+     * Delete the least recently used files in the directory until their total size is
+     * within the limit. The entry just written is never deleted.
+     *
+     * @param keep The path of the entry just written.
+     */
+    void evict(const std::string &keep) const;
+};
+
+#endif
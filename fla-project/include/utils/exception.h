@@ -72,4 +72,15 @@ public:
     }
 };
 
+class ResourceLimitException : public std::exception {
+    std::string message;
+public:
+    // 运行时超出资源限制（如纸带内存上限）
+    explicit ResourceLimitException(const std::string& message) : message(message) {}
+
+    const char* what() const noexcept override {
+        return message.c_str();
+    }
+};
+
 #endif
\ No newline at end of file
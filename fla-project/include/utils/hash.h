@@ -0,0 +1,32 @@
+/**
+ * Content hashing shared by machine fingerprints and caches.
+ */
+
+#ifndef FLA_UTILS_HASH_H
+#define FLA_UTILS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 位 FNV-1a
+const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+/**
+ * Feed len bytes into a running FNV-1a hash.
+ */
+inline void fnv1a(uint64_t &hash, const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= FNV_PRIME;
+    }
+}
+
+inline uint64_t fnv1a(const std::string &data) {
+    uint64_t hash = FNV_OFFSET;
+    fnv1a(hash, data.data(), data.size());
+    return hash;
+}
+
+#endif
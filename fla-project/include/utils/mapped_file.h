@@ -0,0 +1,45 @@
+/**
+ * Read-only memory mapping of a whole file.
+ */
+
+#ifndef FLA_UTILS_MAPPED_FILE_H
+#define FLA_UTILS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Maps a file read-only into memory. 映射是私有的，文件在映射期间被改写时内容可能随之改变，
+ * 因此写文件的一方应先写临时文件再改名。
+ *
+ * The object owns its mapping, so it can be neither copied nor moved.
+ */
+class MappedFile {
+    const char *bytes = nullptr;
+    size_t length = 0;
+
+public:
+
+    /**
+     * @throws std::runtime_error if the file cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @return The content of the file, nullptr if the file is empty.
+     */
+    inline const char *data() const {
+        return bytes;
+    }
+
+    inline size_t size() const {
+        return length;
+    }
+};
+
+#endif
@@ -1,20 +1,91 @@
 /**
- * Util functions to parse a specific token.
+ * Util functions to split configuration files into lines and tokens,
+ * and to parse a specific token.
  */
 
 #ifndef FLA_UTILS_PARSE_TOKEN_H
 #define FLA_UTILS_PARSE_TOKEN_H
 
+#include "utils/string_view.h"
+#include <cstdint>
 #include <string>
 #include <set>
 
+// 字符类别的位，见 CHAR_CLASSES
+const uint8_t CHAR_SPACE = 1;       // 分隔 token 的空白字符，与 isspace 相同
+const uint8_t CHAR_STATE = 2;       // 状态名中的字符 [a-zA-Z0-9_]
+const uint8_t CHAR_SYMBOL = 4;      // 可用作输入、纸带或栈符号的可显示字符，不含 ' ' ',' ';' '{' '}' '*' '_'
+
+// 每个字节所属的类别，代替逐字符的比较和 std::regex
+extern const uint8_t *const CHAR_CLASSES;
+
+inline bool hasCharClass(char c, uint8_t cls) {
+    return (CHAR_CLASSES[static_cast<uint8_t>(c)] & cls) != 0;
+}
+
+/**
+ * @return Whether the token matches [a-zA-Z0-9_]+.
+ */
+bool isStateName(StringView token);
+
 /**
  * A str set is "{abc,ac,ab ,d c}".
  * parse a str to std::set<std::string>
  * space will not be ignored
  */
-std::set<std::string> parseStrSet(const std::string &input);
+std::set<std::string> parseStrSet(StringView input);
+
+std::set<char> parseCharSet(StringView input);
+
+/**
+ * Splits the text of a configuration file into lines and whitespace separated tokens
+ * in a single pass, without copying. The views point into the text, which must outlive them.
+ *
+ * 每行去掉 ';' 之后的注释和行尾的空格、制表符；行号从 1 开始，空行也计数。
+ * 只记录前 MAX_TOKENS 个 token 的位置，token 的总数另外计数。
+ */
+class LineTokenizer {
+public:
+    static const size_t MAX_TOKENS = 5;
+
+private:
+    StringView text;
+    size_t pos = 0;
+
+    StringView current;
+    int line_idx = 0;
+    StringView tokens[MAX_TOKENS];
+    size_t token_num = 0;
+
+public:
+
+    explicit LineTokenizer(StringView text) : text(text) {}
+
+    /**
+     * Move to the next line.
+     *
+     * @return false if there are no more lines.
+     */
+    bool next();
+
+    inline StringView line() const {
+        return current;
+    }
+
+    inline int lineIndex() const {
+        return line_idx;
+    }
+
+    inline size_t tokenNum() const {
+        return token_num;
+    }
 
-std::set<char> parseCharSet(const std::string &input);
+    /**
+     * @param i Index of the token, less than both tokenNum() and MAX_TOKENS.
+     */
+    inline StringView token(size_t i) const {
+        return tokens[i];
+    }
+};
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,49 @@
+/**
+ * Per-run resource limits shared by the emulators.
+ */
+
+#ifndef FLA_UTILS_RUN_LIMITS_H
+#define FLA_UTILS_RUN_LIMITS_H
+
+#include <chrono>
+#include <cstddef>
+
+/**
+ * Limits for a single run of an emulator. 0 means no limit.
+ */
+struct RunLimits {
+    long long max_steps = 0;        // 最多运行的步数
+    long long time_limit_ms = 0;    // 墙钟时间（毫秒）
+    size_t max_memory = 0;          // TM 每条纸带或 PDA 栈的大小上限（字节）
+};
+
+/**
+ * Wall-clock deadline of a run. Reading the clock costs far more than a step,
+ * so the clock is only looked at once every CHECK_INTERVAL steps reported to expired().
+ */
+class RunDeadline {
+    static const int CHECK_INTERVAL = 1 << 12;
+
+    bool enabled;
+    std::chrono::steady_clock::time_point deadline;
+    long long countdown = CHECK_INTERVAL;
+
+public:
+
+    explicit RunDeadline(long long time_limit_ms)
+        : enabled(time_limit_ms > 0),
+          deadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(time_limit_ms)) {}
+
+    /**
+     * @param steps The steps run since the last call, for callers that take many steps at once.
+     */
+    inline bool expired(long long steps = 1) {
+        if (!enabled || (countdown -= steps) > 0) {
+            return false;
+        }
+        countdown = CHECK_INTERVAL;
+        return std::chrono::steady_clock::now() >= deadline;
+    }
+};
+
+#endif
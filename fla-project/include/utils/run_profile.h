@@ -0,0 +1,58 @@
+/**
+ * Execution profile of a run, shared by the emulators.
+ */
+
+#ifndef FLA_UTILS_RUN_PROFILE_H
+#define FLA_UTILS_RUN_PROFILE_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Where a run spent its steps, collected by an emulator in profile mode.
+ *
+ * 运行时只有 transition_hits 逐步计数：它是按转移编号下标的数组，每步增加一个计数，
+ * 开销足够小，可以一直打开。其余字段在运行结束时由模拟器填写，各状态的步数由转移的源状态汇总得到。
+ */
+struct RunProfile {
+    std::string machine;                        // "tm" 或 "pda"
+
+    std::vector<long long> transition_hits;     // 每个转移被使用的次数
+    std::vector<std::string> transition_names;  // 转移在源文件中的写法
+    std::vector<int> transition_states;         // 转移的源状态编号
+    std::vector<char> wildcard;                 // TM 中含 '*' 的转移，PDA 中的空转移
+    std::string wildcard_label;                 // 报告中对 wildcard 的称呼
+
+    std::vector<std::string> state_names;
+
+    // 每条纸带访问过的格子数，或栈的最大深度
+    std::vector<std::pair<std::string, size_t>> high_water;
+
+    long long steps = 0;
+    double seconds = 0;
+
+    /**
+     * Clear the counters for a run of a machine with transition_num transitions.
+     */
+    void reset(size_t transition_num);
+
+    /**
+     * @return The number of steps taken from each state, indexed by state id.
+     */
+    std::vector<long long> stateHits() const;
+
+    /**
+     * Write a human-readable report, states and transitions sorted by steps.
+     */
+    void writeText(std::ostream &out) const;
+
+    /**
+     * Write the profile as a JSON document.
+     */
+    void writeJson(std::ostream &out) const;
+};
+
+#endif
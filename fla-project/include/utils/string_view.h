@@ -0,0 +1,84 @@
+/**
+ * A minimal non-owning view of a character range, standing in for C++17 std::string_view.
+ */
+
+#ifndef FLA_UTILS_STRING_VIEW_H
+#define FLA_UTILS_STRING_VIEW_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+/**
+ * A pointer and a length into characters owned by someone else, usually a mapped file.
+ * 只提供解析器用到的操作，语义与 std::string_view 的同名函数相同。
+ */
+class StringView {
+    const char *ptr = nullptr;
+    size_t len = 0;
+
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    StringView() = default;
+
+    StringView(const char *data, size_t size) : ptr(data), len(size) {}
+
+    StringView(const std::string &str) : ptr(str.data()), len(str.size()) {}
+
+    StringView(const char *str) : ptr(str), len(std::strlen(str)) {}
+
+    inline const char *data() const {
+        return ptr;
+    }
+
+    inline size_t size() const {
+        return len;
+    }
+
+    inline bool empty() const {
+        return len == 0;
+    }
+
+    inline const char *begin() const {
+        return ptr;
+    }
+
+    inline const char *end() const {
+        return ptr + len;
+    }
+
+    inline char operator[](size_t i) const {
+        return ptr[i];
+    }
+
+    inline char front() const {
+        return ptr[0];
+    }
+
+    inline StringView substr(size_t pos, size_t count = npos) const {
+        return StringView(ptr + pos, count < len - pos ? count : len - pos);
+    }
+
+    inline size_t find(char ch, size_t pos = 0) const {
+        if (pos >= len) {
+            return npos;
+        }
+        const void *found = std::memchr(ptr + pos, ch, len - pos);
+        return found == nullptr ? npos : static_cast<const char *>(found) - ptr;
+    }
+
+    inline std::string str() const {
+        return std::string(ptr, len);
+    }
+
+    inline bool operator==(StringView other) const {
+        return len == other.len && (len == 0 || std::memcmp(ptr, other.ptr, len) == 0);
+    }
+
+    inline bool operator!=(StringView other) const {
+        return !(*this == other);
+    }
+};
+
+#endif
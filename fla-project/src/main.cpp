@@ -1,4 +1,11 @@
+#include <climits>
+#include <cstdio>
+#include <csignal>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <memory>
+#include <thread>
 
 #include <string>
 #include <vector>
@@ -10,105 +17,741 @@
 
 #include "tm/parser.h"
 #include "tm/emulator.h"
+#include "tm/trace_file.h"
 
+#include "server/daemon.h"
+
+#include "utils/batch_runner.h"
+#include "utils/disk_cache.h"
 #include "utils/exception.h"
+#include "utils/mapped_file.h"
+#include "utils/run_limits.h"
 
-// 假设 PDAHandler 和 TMHandler 的接口
-void PDAHandler(const std::string& pdaFile, const std::string& inputStr, bool verbose) {
-    PDAContext context = PDAParser::parse(pdaFile);
-    PDAEmulator emulator(context);
-    emulator.setVerboseMode(verbose);
-    bool result = emulator.run(inputStr);
-    if (!verbose) {
-        std::cout << (result ? "true" : "false") << std::endl;
+// 命令行选项
+struct Options {
+    std::string automataFile;
+    std::string inputStr;
+    std::string inputFile;      // 从文件流式读入 PDA 的输入，"-" 表示标准输入
+    bool verbose = false;
+    bool showHelp = false;
+    TMTapeBackend tapeBackend = TMTapeBackend::VECTOR;
+    PDAStackBackend stackBackend = PDAStackBackend::CONTIGUOUS;
+    bool nondeterministic = false;  // 按非确定性 PDA 运行
+    bool accel = false;
+    int macroBlock = 0;
+    bool detectLoops = false;
+    RunLimits limits;
+    std::string checkpointFile;
+    long long checkpointEvery = 0;
+    std::string resumeFile;
+    std::string batchFile;      // 逐行读入输入的文件，"-" 表示标准输入
+    int jobs = 0;               // 批处理或服务的工作线程数，0 表示按 CPU 核数
+    std::string socketPath;     // 服务模式监听的 Unix 套接字
+    bool compile = false;       // fla compile：把机器预编译为 .tmc / .pdac
+    std::string outputFile;     // 预编译的输出文件，默认为输入文件名后加 c
+    bool useCache = true;       // 是否使用磁盘上的预编译缓存
+    TMTraceOptions trace;       // verbose 模式输出哪些格局
+    std::string profileFile;    // 性能分析的 JSON 报告
+    std::string recordFile;     // 记录二进制轨迹的文件
+    long long keyframeEvery = 1000000;  // 记录轨迹时保存关键帧的步数间隔
+    std::string traceCommand;   // fla trace 的子命令：render 或 inspect
+    std::string traceFile;
+    long long traceFirst = 0;   // 回放时输出的步数范围
+    long long traceLast = LLONG_MAX;
+};
+
+// 检查字符串是否以指定后缀结尾
+bool endsWith(const std::string& str, const std::string& suffix) {
+    if (str.size() >= suffix.size()) {
+        return str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    return false;
+}
+
+// 运行达到上限时输出停止的位置，返回进程的退出码
+int reportLimit(const std::string& limit, long long steps, const std::string& state) {
+    std::cerr << limit << " limit reached after " << steps << " steps in state " << state << std::endl;
+    return 3;
+}
+
+// 输出性能分析的报告：文本写到标准错误，JSON 写到 file
+void writeProfile(const RunProfile& profile, const std::string& file) {
+    profile.writeText(std::cerr);
+    std::ofstream out(file);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to write file: " + file);
+    }
+    profile.writeJson(out);
+}
+
+// 批处理模式下每个输入对应的一行结果
+std::string describePDARun(PDAEmulator& emulator, const std::string& input) {
+    try {
+        switch (emulator.simulate(input).status) {
+        case PDARunStatus::ACCEPT:
+            return "true";
+        case PDARunStatus::REJECT:
+            return "false";
+        case PDARunStatus::STEP_LIMIT:
+            return "step limit reached";
+        case PDARunStatus::TIME_LIMIT:
+            return "time limit reached";
+        default:
+            return "memory limit reached";
+        }
+    } catch (const InputSyntaxError& e) {
+        return "illegal input";
+    }
+}
+
+std::string describeTMRun(TMEmulator& emulator, const std::string& input) {
+    try {
+        auto result = emulator.simulate(input);
+        switch (result.status) {
+        case TMRunStatus::NON_HALTING:
+            return "non-halting";
+        case TMRunStatus::STEP_LIMIT:
+            return "step limit reached";
+        case TMRunStatus::TIME_LIMIT:
+            return "time limit reached";
+        case TMRunStatus::MEMORY_LIMIT:
+            return "memory limit reached";
+        default:
+            return result.output;
+        }
+    } catch (const InputSyntaxError& e) {
+        return "illegal input";
+    }
+}
+
+// 按选项设置 TM 模拟器（快照相关的选项除外）
+void configureTM(TMEmulator& emulator, const Options& options) {
+    emulator.setVerboseMode(options.verbose);
+    emulator.setTraceOptions(options.trace);
+    emulator.setTapeBackend(options.tapeBackend);
+    emulator.setLimits(options.limits);
+    emulator.setAccelerated(options.accel);
+    emulator.setMacroBlock(options.macroBlock);
+    emulator.setLoopDetection(options.detectLoops);
+}
+
+// 不使用缓存时目录为空
+DiskCache diskCache(const Options& options) {
+    return DiskCache(options.useCache ? DiskCache::defaultDirectory() : "");
+}
+
+// 读入 PDA：.pdac 文件和缓存命中时直接映射，不需要解析和编译
+std::shared_ptr<const PDAProgram> loadPDA(const std::string& file, const Options& options) {
+    if (endsWith(file, ".pdac")) {
+        return PDAProgram::load(file);
+    }
+    MappedFile source(file);
+    StringView text(source.data(), source.size());
+    DiskCache cache = diskCache(options);
+    std::string entry = cache.entryPath(text, PDAProgram::FILE_VERSION, "pdac");
+    if (!entry.empty()) {
+        try {
+            auto program = PDAProgram::load(entry);
+            if (program->getSource() == text) {
+                cache.touch(entry);
+                return program;
+            }
+        } catch (const std::runtime_error&) {
+        }
+        // 没有缓存项，或缓存项已损坏、属于另一份源文件，删除后重新解析
+        std::remove(entry.c_str());
+    }
+    auto program = PDAEmulator(PDAParser::parseContent(text)).getProgram();
+    if (!entry.empty() && program->isDense()) {
+        try {
+            program->save(entry, text);
+            cache.evict(entry);
+        } catch (const std::runtime_error&) {
+        }
+    }
+    return program;
+}
+
+// 读入 TM：.tmc 文件和缓存命中时直接映射，不需要解析和编译
+std::shared_ptr<const TMProgram> loadTM(const std::string& file, const Options& options) {
+    if (endsWith(file, ".tmc")) {
+        return TMProgram::load(file);
+    }
+    MappedFile source(file);
+    StringView text(source.data(), source.size());
+    DiskCache cache = diskCache(options);
+    std::string entry = cache.entryPath(text, TMProgram::FILE_VERSION, "tmc");
+    if (!entry.empty()) {
+        try {
+            auto program = TMProgram::load(entry);
+            if (program->getSource() == text) {
+                cache.touch(entry);
+                return program;
+            }
+        } catch (const std::runtime_error&) {
+        }
+        // 没有缓存项，或缓存项已损坏、属于另一份源文件，删除后重新解析
+        std::remove(entry.c_str());
+    }
+    auto program = TMEmulator(TMParser::parseContent(text)).getProgram();
+    if (!entry.empty() && program->isDense()) {
+        try {
+            program->save(entry, text);
+            cache.evict(entry);
+        } catch (const std::runtime_error&) {
+        }
+    }
+    return program;
+}
+
+bool isPDAFile(const std::string& file) {
+    return endsWith(file, ".pda") || endsWith(file, ".pdac");
+}
+
+bool isTMFile(const std::string& file) {
+    return endsWith(file, ".tm") || endsWith(file, ".tmc");
+}
+
+const char* const UNSUPPORTED_TYPE = "Unsupported automata type. File must have extension .pda, .pdac, .tm or .tmc";
+
+int jobCount(const Options& options) {
+    return options.jobs > 0 ? options.jobs : static_cast<int>(std::thread::hardware_concurrency());
+}
+
+// 批处理：只解析一次机器，多个线程各自持有模拟器运行所有输入
+void BatchHandler(const Options& options) {
+    std::ifstream file;
+    if (options.batchFile != "-") {
+        file.open(options.batchFile);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file: " + options.batchFile);
+        }
+    }
+    std::istream& in = options.batchFile == "-" ? std::cin : file;
+
+    BatchRunner runner(jobCount(options));
+
+    if (isPDAFile(options.automataFile)) {
+        auto program = loadPDA(options.automataFile, options);
+        runner.run(in, std::cout, [&]() {
+            auto emulator = std::make_shared<PDAEmulator>(program);
+            emulator->setLimits(options.limits);
+            emulator->setStackBackend(options.stackBackend);
+            emulator->setNondeterministic(options.nondeterministic);
+            return [emulator](const std::string& input) { return describePDARun(*emulator, input); };
+        });
+    } else if (isTMFile(options.automataFile)) {
+        auto program = loadTM(options.automataFile, options);
+        runner.run(in, std::cout, [&]() {
+            auto emulator = std::make_shared<TMEmulator>(program);
+            configureTM(*emulator, options);
+            return [emulator](const std::string& input) { return describeTMRun(*emulator, input); };
+        });
+    } else {
+        throw std::invalid_argument(UNSUPPORTED_TYPE);
+    }
+}
+
+// 预编译：检查机器并写出可以直接映射的文件
+void CompileHandler(const Options& options) {
+    const std::string& source = options.automataFile;
+    std::string target = options.outputFile.empty() ? source + "c" : options.outputFile;
+    if (endsWith(source, ".pda")) {
+        PDAEmulator(PDAParser::parse(source)).getProgram()->save(target);
+    } else if (endsWith(source, ".tm")) {
+        TMEmulator(TMParser::parse(source)).getProgram()->save(target);
+    } else {
+        throw std::invalid_argument("Only .pda and .tm files can be compiled");
+    }
+}
+
+// 回放二进制轨迹，按 verbose 模式的格式输出 [traceFirst, traceLast] 步的格局
+void TraceRenderHandler(const Options& options) {
+    TMTraceReplay replay(options.traceFile, loadTM(options.automataFile, options));
+    if (!replay.seek(options.traceFirst)) {
+        throw std::runtime_error("The trace ends at step " + std::to_string(replay.getStep()));
+    }
+    TMTraceWriter writer(std::cout);
+    while (replay.getStep() <= options.traceLast) {
+        replay.render(writer);
+        if (!replay.step()) {
+            break;
+        }
+    }
+}
+
+// 交互地查看轨迹：从标准输入逐行读入命令，每条命令之后输出当前的格局
+void TraceInspectHandler(const Options& options) {
+    TMTraceReplay replay(options.traceFile, loadTM(options.automataFile, options));
+    TMTraceWriter writer(std::cout);
+    auto show = [&](bool reached) {
+        if (!reached) {
+            writer.line("End of trace at step " + std::to_string(replay.getStep()));
+        }
+        replay.render(writer);
+        writer.flush();
+    };
+    show(replay.seek(options.traceFirst));
+
+    const std::string usage = "commands: n|next [k], b|back [k], g|goto <step>, q|quit";
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream in(line);
+        std::string command;
+        std::string arg;
+        std::string extra;
+        if (!(in >> command)) {
+            continue;
+        }
+        in >> arg >> extra;
+
+        // 参数只能是非负整数：n 和 b 的步数可以省略（默认为 1），g 的步数必须给出，q 没有参数
+        bool has_arg = !arg.empty();
+        bool numeric = arg.size() <= 18 && arg.find_first_not_of("0123456789") == std::string::npos;
+        bool valid = extra.empty() && (!has_arg || numeric);
+        long long n = 1;
+        if (valid && has_arg) {
+            n = std::stoll(arg);
+        }
+        if (command == "q" || command == "quit") {
+            valid = valid && !has_arg;
+        } else if (command == "g" || command == "goto") {
+            valid = valid && has_arg;
+        } else if (command != "n" && command != "next" && command != "b" && command != "back") {
+            valid = false;
+        }
+        if (!valid) {
+            writer.line(usage);
+            writer.flush();
+            continue;
+        }
+
+        if (command == "q" || command == "quit") {
+            break;
+        } else if (command == "n" || command == "next") {
+            show(replay.seek(replay.getStep() + n));
+        } else if (command == "b" || command == "back") {
+            replay.back(n);
+            show(true);
+        } else {
+            show(replay.seek(n));
+        }
     }
 }
 
-void TMHandler(const std::string& tmFile, const std::string& inputStr, bool verbose) {
-    TMContext context = TMParser::parse(tmFile);
-    TMEmulator emulator(context);
+// 服务模式：一直运行，直到进程被杀死
+void ServeHandler(const Options& options) {
+    // 客户端断开后写套接字不应杀死服务进程
+    std::signal(SIGPIPE, SIG_IGN);
+    Daemon daemon(options.socketPath, jobCount(options), options.limits,
+                  [&options](TMEmulator& emulator) { configureTM(emulator, options); });
+    daemon.serve();
+}
+
+// 假设 PDAHandler 和 TMHandler 的接口，返回进程的退出码
+int PDAHandler(const std::string& pdaFile, const std::string& inputStr, const Options& options) {
+    bool verbose = options.verbose;
+    PDAEmulator emulator(loadPDA(pdaFile, options));
     emulator.setVerboseMode(verbose);
-    auto result = emulator.run(inputStr);
+    emulator.setLimits(options.limits);
+    emulator.setStackBackend(options.stackBackend);
+    emulator.setNondeterministic(options.nondeterministic);
+    RunProfile profile;
+    if (!options.profileFile.empty()) {
+        emulator.setProfile(&profile);
+    }
+    auto result = options.inputFile.empty() ? emulator.simulate(inputStr) : emulator.simulateFile(options.inputFile);
+    if (!options.profileFile.empty()) {
+        writeProfile(profile, options.profileFile);
+    }
+    switch (result.status) {
+    case PDARunStatus::STEP_LIMIT:
+        return reportLimit("step", result.steps, result.state);
+    case PDARunStatus::TIME_LIMIT:
+        return reportLimit("time", result.steps, result.state);
+    case PDARunStatus::MEMORY_LIMIT:
+        return reportLimit("stack memory", result.steps, result.state);
+    default:
+        break;
+    }
     if (!verbose) {
-        std::cout << result << std::endl;
+        std::cout << (result.status == PDARunStatus::ACCEPT ? "true" : "false") << std::endl;
     }
+    return 0;
 }
 
-// 检查字符串是否以指定后缀结尾
-bool endsWith(const std::string& str, const std::string& suffix) {
-    if (str.size() >= suffix.size()) {
-        return str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+// 检测到不停机时退出码为 2
+int TMHandler(const std::string& tmFile, const std::string& inputStr, const Options& options) {
+    bool verbose = options.verbose;
+    std::shared_ptr<const TMProgram> program;
+    if (!verbose || endsWith(tmFile, ".tmc")) {
+        program = loadTM(tmFile, options);
+    } else {
+        // verbose 模式需要源文件中的转移来给出警告，不经过缓存
+        TMContext context = TMParser::parse(tmFile);
+        for (const auto& overlap : context.transitions.findAmbiguousOverlaps()) {
+            std::cerr << "warning: " << overlap << std::endl;
+        }
+        program = TMEmulator(context).getProgram();
     }
-    return false;
+    TMEmulator emulator(program);
+    configureTM(emulator, options);
+    emulator.setCheckpoint(options.checkpointFile, options.checkpointEvery);
+    emulator.setTraceFile(options.recordFile, options.keyframeEvery);
+    RunProfile profile;
+    if (!options.profileFile.empty()) {
+        emulator.setProfile(&profile);
+    }
+    if (!options.checkpointFile.empty()) {
+        // 收到 SIGTERM 时保存快照后退出
+        std::signal(SIGTERM, [](int) { TMEmulator::requestStop(); });
+    }
+    auto result = options.resumeFile.empty() ? emulator.simulate(inputStr)
+                                             : emulator.resume(TMSnapshot::load(options.resumeFile));
+    if (!options.profileFile.empty()) {
+        writeProfile(profile, options.profileFile);
+    }
+    if (result.status == TMRunStatus::NON_HALTING) {
+        std::cerr << "non-halting: cycle of " << result.cycle.length << " steps (shift " << result.cycle.shift
+                  << ") found at step " << result.cycle.found_at << std::endl;
+        return 2;
+    }
+    switch (result.status) {
+    case TMRunStatus::STEP_LIMIT:
+        return reportLimit("step", result.steps, result.state);
+    case TMRunStatus::TIME_LIMIT:
+        return reportLimit("time", result.steps, result.state);
+    case TMRunStatus::MEMORY_LIMIT:
+        return reportLimit("tape memory", result.steps, result.state);
+    case TMRunStatus::INTERRUPTED:
+        std::cerr << "interrupted after " << result.steps << " steps, snapshot saved to " << options.checkpointFile
+                  << std::endl;
+        return 4;
+    default:
+        break;
+    }
+    if (!verbose) {
+        std::cout << result.output << std::endl;
+    }
+    return 0;
 }
 
 // 打印帮助信息
 void printHelp() {
     std::cout << "usage: fla [-v|--verbose] [-h|--help] <pda> <input>\n"
                  "       fla [-v|--verbose] [-h|--help] <tm> <input>\n"
+                 "       fla [-v|--verbose] --resume <snapshot> <tm>\n"
+                 "       fla --input <file|-> <pda>\n"
+                 "       fla --batch <file|-> [--jobs <n>] <pda|tm>\n"
+                 "       fla --serve <socket> [--jobs <n>]\n"
+                 "       fla compile <pda|tm> [output]\n"
+                 "       fla trace render <trace> <tm> [first [last]]\n"
+                 "       fla trace inspect <trace> <tm> [step]\n"
+                 "\n<pda> and <tm> may also be .pdac and .tmc files written by fla compile,\n"
+                 "which load without parsing (output defaults to the input name followed by c)\n"
                  "\noptions:\n"
                  "  -v, --verbose          Enable verbose mode\n"
-                 "  -h, --help             Print usage\n";
+                 "  -h, --help             Print usage\n"
+                 "  --trace-every <n>      Print only every n-th TM configuration in verbose mode\n"
+                 "  --trace-on-change      Print only TM configurations whose state changed\n"
+                 "  --trace-window <w>     Print only w cells on each side of the TM heads\n"
+                 "  --tape <vector|packed|mmap>\n"
+                 "                         TM tape storage, packed uses 1/2/4 bits per cell,\n"
+                 "                         mmap commits reserved virtual memory on demand\n"
+                 "  --stack <contiguous|runs>\n"
+                 "                         PDA stack storage, runs keeps one entry per run of\n"
+                 "                         equal symbols (constant memory for a^n b^n)\n"
+                 "  --nondeterministic     Run the PDA nondeterministically, following every\n"
+                 "                         applicable transition (also repeated ones), accepting\n"
+                 "                         if any path does\n"
+                 "  --max-steps <n>        Stop the run after n steps (exit code 3)\n"
+                 "  --time-limit <ms>      Stop the run after ms milliseconds (exit code 3)\n"
+                 "  --memory-limit <MiB>   Stop the run if a TM tape or the PDA stack needs more\n"
+                 "                         memory (exit code 3), --tape-limit is the same\n"
+                 "  --checkpoint <file>    Save a TM snapshot to file on SIGTERM and stop (exit code 4)\n"
+                 "  --checkpoint-every <n> Also save the snapshot every n steps\n"
+                 "  --resume <file>        Continue a TM run from a snapshot\n"
+                 "  --profile <file>       Count the steps of each transition and state, print a\n"
+                 "                         report to stderr and write it as JSON to file\n"
+                 "  --record <file>        Record every step of the TM run to a binary trace,\n"
+                 "                         shown again by fla trace render or fla trace inspect\n"
+                 "  --keyframe-every <n>   Save a full configuration every n steps of a recorded\n"
+                 "                         run, so replays can seek (default 1000000, 0 for none)\n"
+                 "  --accel                Skip TM sweeps over runs of equal cells\n"
+                 "  --macro <k>            Run single tape TMs as a macro machine over k-cell blocks\n"
+                 "  --detect-loops         Stop TM runs that provably never halt (exit code 2)\n"
+                 "  --input <file|->       Read the PDA input from file (or stdin) instead of the\n"
+                 "                         command line, streaming it so any length fits\n"
+                 "  --batch <file|->       Run every line of file (or stdin) as an input,\n"
+                 "                         printing one result line per input in order\n"
+                 "  --serve <socket>       Answer run requests on a Unix socket, keeping parsed\n"
+                 "                         machines cached (protocol in include/server/daemon.h)\n"
+                 "  --no-cache             Do not use or fill the cache of compiled machines\n"
+                 "                         in $XDG_CACHE_HOME/fla (or ~/.cache/fla)\n"
+                 "  --jobs <n>             Worker threads for --batch and --serve, defaults to\n"
+                 "                         the CPU count\n";
 }
 
 // 解析命令行参数
-void parseArguments(int argc, char* argv[], 
-                    std::string& automataFile, 
-                    std::string& inputStr, 
-                    bool& verbose, 
-                    bool& showHelp) {
-    verbose = false;
-    showHelp = false;
+void parseArguments(int argc, char* argv[], Options& options) {
     std::vector<std::string> positionalArgs;
 
+    // 取出选项后面紧跟的参数
+    auto nextArg = [&](int& i, const std::string& arg) {
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        return std::string(argv[++i]);
+    };
+
+    // 取出资源上限，必须是不超过 max 的非负整数
+    auto limitArg = [&](int& i, const std::string& arg, long long max) {
+        std::string value = nextArg(i, arg);
+        size_t end = 0;
+        long long limit = -1;
+        try {
+            limit = std::stoll(value, &end);
+        } catch (const std::logic_error&) {
+        }
+        if (end != value.size() || limit < 0 || limit > max) {
+            throw std::invalid_argument("Invalid value for " + arg + ": " + value);
+        }
+        return limit;
+    };
+
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
 
         if (arg == "-h" || arg == "--help") {
-            showHelp = true;
+            options.showHelp = true;
         } else if (arg == "-v" || arg == "--verbose") {
-            verbose = true;
+            options.verbose = true;
+        } else if (arg == "--trace-every") {
+            options.trace.every = std::stoll(nextArg(i, arg));
+        } else if (arg == "--trace-on-change") {
+            options.trace.state_changes = true;
+        } else if (arg == "--trace-window") {
+            options.trace.window = std::stoi(nextArg(i, arg));
+        } else if (arg == "--tape") {
+            std::string backend = nextArg(i, arg);
+            if (backend == "vector") {
+                options.tapeBackend = TMTapeBackend::VECTOR;
+            } else if (backend == "packed") {
+                options.tapeBackend = TMTapeBackend::PACKED;
+            } else if (backend == "mmap") {
+                options.tapeBackend = TMTapeBackend::MAPPED;
+            } else {
+                throw std::invalid_argument("Unknown tape backend: " + backend);
+            }
+        } else if (arg == "--stack") {
+            std::string backend = nextArg(i, arg);
+            if (backend == "contiguous") {
+                options.stackBackend = PDAStackBackend::CONTIGUOUS;
+            } else if (backend == "runs") {
+                options.stackBackend = PDAStackBackend::RUN_LENGTH;
+            } else {
+                throw std::invalid_argument("Unknown stack backend: " + backend);
+            }
+        } else if (arg == "--nondeterministic") {
+            options.nondeterministic = true;
+        } else if (arg == "--input") {
+            options.inputFile = nextArg(i, arg);
+        } else if (arg == "--profile") {
+            options.profileFile = nextArg(i, arg);
+        } else if (arg == "--record") {
+            options.recordFile = nextArg(i, arg);
+        } else if (arg == "--keyframe-every") {
+            options.keyframeEvery = std::stoll(nextArg(i, arg));
+        } else if (arg == "--accel") {
+            options.accel = true;
+        } else if (arg == "--detect-loops") {
+            options.detectLoops = true;
+        } else if (arg == "--macro") {
+            options.macroBlock = std::stoi(nextArg(i, arg));
+        } else if (arg == "--batch") {
+            options.batchFile = nextArg(i, arg);
+        } else if (arg == "--serve") {
+            options.socketPath = nextArg(i, arg);
+        } else if (arg == "--no-cache") {
+            options.useCache = false;
+        } else if (arg == "--jobs") {
+            options.jobs = std::stoi(nextArg(i, arg));
+        } else if (arg == "--checkpoint") {
+            options.checkpointFile = nextArg(i, arg);
+        } else if (arg == "--checkpoint-every") {
+            options.checkpointEvery = std::stoll(nextArg(i, arg));
+        } else if (arg == "--resume") {
+            options.resumeFile = nextArg(i, arg);
+        } else if (arg == "--max-steps") {
+            options.limits.max_steps = limitArg(i, arg, LLONG_MAX);
+        } else if (arg == "--time-limit") {
+            options.limits.time_limit_ms = limitArg(i, arg, LLONG_MAX);
+        } else if (arg == "--memory-limit" || arg == "--tape-limit") {
+            options.limits.max_memory = static_cast<size_t>(limitArg(i, arg, LLONG_MAX >> 20)) << 20;
         } else {
             positionalArgs.push_back(arg);
         }
     }
 
-    if (showHelp) {
+    if (options.showHelp) {
         return; // 如果请求帮助，则无需检查其他参数
     }
 
+    if (!positionalArgs.empty() && positionalArgs[0] == "compile") {
+        if (positionalArgs.size() < 2 || positionalArgs.size() > 3) {
+            throw std::invalid_argument("Usage: fla compile <pda|tm> [output]");
+        }
+        options.compile = true;
+        options.automataFile = positionalArgs[1];
+        if (positionalArgs.size() == 3) {
+            options.outputFile = positionalArgs[2];
+        }
+        return;
+    }
+
+    if (!positionalArgs.empty() && positionalArgs[0] == "trace") {
+        size_t count = positionalArgs.size();
+        bool render = count >= 2 && positionalArgs[1] == "render";
+        bool inspect = count >= 2 && positionalArgs[1] == "inspect";
+        if (!(render && count >= 4 && count <= 6) && !(inspect && count >= 4 && count <= 5)) {
+            throw std::invalid_argument("Usage: fla trace render <trace> <tm> [first [last]]\n"
+                                        "       fla trace inspect <trace> <tm> [step]");
+        }
+        options.traceCommand = positionalArgs[1];
+        options.traceFile = positionalArgs[2];
+        options.automataFile = positionalArgs[3];
+        if (count >= 5) {
+            options.traceFirst = std::stoll(positionalArgs[4]);
+        }
+        if (count == 6) {
+            options.traceLast = std::stoll(positionalArgs[5]);
+        }
+        return;
+    }
+
+    // 服务模式下机器和输入都来自请求
+    if (!options.socketPath.empty()) {
+        if (!positionalArgs.empty()) {
+            throw std::invalid_argument("--serve takes no automata file or input");
+        }
+        return;
+    }
+
+    // 从快照继续时输入已经在纸带上，批处理或 --input 时输入从文件读入
+    if ((!options.resumeFile.empty() || !options.batchFile.empty() || !options.inputFile.empty()) &&
+        positionalArgs.size() == 1) {
+        options.automataFile = positionalArgs[0];
+        return;
+    }
+
     if (positionalArgs.size() < 2) {
         throw std::invalid_argument("Both automata file and input file are required!");
     }
 
-    automataFile = positionalArgs[0];
-    inputStr = positionalArgs[1];
+    options.automataFile = positionalArgs[0];
+    options.inputStr = positionalArgs[1];
 }
 
 int main(int argc, char* argv[]) {
-    std::string automataFile;
-    std::string inputStr;
-    bool verbose = false;
-    bool showHelp = false;
+    Options options;
+    bool& verbose = options.verbose;
     
     try {
 
         // 解析命令行参数
-        parseArguments(argc, argv, automataFile, inputStr, verbose, showHelp);
+        parseArguments(argc, argv, options);
 
         // 如果是帮助请求，打印帮助信息并退出
-        if (showHelp) {
+        if (options.showHelp) {
             printHelp();
             return 0;
         }
 
+        const std::string& automataFile = options.automataFile;
+        const std::string& inputStr = options.inputStr;
+
+        if (options.compile) {
+            CompileHandler(options);
+            return 0;
+        }
+
+        if (options.traceCommand == "render") {
+            TraceRenderHandler(options);
+            return 0;
+        }
+        if (options.traceCommand == "inspect") {
+            TraceInspectHandler(options);
+            return 0;
+        }
+
+        // 宏机器模式总是使用 vector 纸带
+        if (options.macroBlock > 1 && options.tapeBackend != TMTapeBackend::VECTOR) {
+            throw std::invalid_argument("--tape cannot be used with --macro");
+        }
+
+        if (!options.socketPath.empty()) {
+            if (verbose) {
+                throw std::invalid_argument("--verbose cannot be used with --serve");
+            }
+            if (!options.recordFile.empty()) {
+                throw std::invalid_argument("--record cannot be used with --serve");
+            }
+            if (!options.profileFile.empty()) {
+                throw std::invalid_argument("--profile cannot be used with --serve");
+            }
+            if (options.nondeterministic) {
+                throw std::invalid_argument("--nondeterministic cannot be used with --serve");
+            }
+            ServeHandler(options);
+            return 0;
+        }
+
+        if (!options.recordFile.empty() && !isTMFile(automataFile)) {
+            throw std::invalid_argument("--record is only supported for TM");
+        }
+
+        if (options.nondeterministic) {
+            if (!options.profileFile.empty()) {
+                throw std::invalid_argument("--profile cannot be used with --nondeterministic");
+            }
+            if (!isPDAFile(automataFile)) {
+                throw std::invalid_argument("--nondeterministic is only supported for PDA");
+            }
+        }
+
+        if (!options.inputFile.empty()) {
+            if (!options.batchFile.empty()) {
+                throw std::invalid_argument("--input cannot be used with --batch");
+            }
+            if (verbose) {
+                throw std::invalid_argument("--verbose cannot be used with --input");
+            }
+            if (!isPDAFile(automataFile)) {
+                throw std::invalid_argument("--input is only supported for PDA");
+            }
+        }
+
+        if (!options.batchFile.empty()) {
+            if (verbose) {
+                throw std::invalid_argument("--verbose cannot be used with --batch");
+            }
+            if (!options.recordFile.empty()) {
+                throw std::invalid_argument("--record cannot be used with --batch");
+            }
+            if (!options.profileFile.empty()) {
+                throw std::invalid_argument("--profile cannot be used with --batch");
+            }
+            BatchHandler(options);
+            return 0;
+        }
+
         // 判断文件类型并调用对应 Handler
-        if (endsWith(automataFile, ".pda")) {
-            PDAHandler(automataFile, inputStr, verbose);
-        } else if (endsWith(automataFile, ".tm")) {
-            TMHandler(automataFile, inputStr, verbose);
+        if (isPDAFile(automataFile)) {
+            return PDAHandler(automataFile, inputStr, options);
+        } else if (isTMFile(automataFile)) {
+            return TMHandler(automataFile, inputStr, options);
         } else {
-            throw std::invalid_argument("Unsupported automata type. File must have extension .pda or .tm");
+            throw std::invalid_argument(UNSUPPORTED_TYPE);
         }
 
     } catch (const InputSyntaxError& e) {
@@ -132,6 +775,9 @@ int main(int argc, char* argv[]) {
             std::cerr << e.what() << std::endl;
         }
         return 1;
+    } catch (const ResourceLimitException& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     } catch (const std::exception& e) {
         // 打印错误信息并退出
         std::cerr << "Error: " << e.what() << std::endl;
@@ -31,40 +31,46 @@ bool PDAContext::validate() const {
     }
 
 
-    // 4. 检查 transitions 中的每个键值对是否有效
+    // 4. 检查 transitions 和 overridden 中的每个键值对是否有效
     for (auto it = transitions.begin(); it != transitions.end(); ++it) {
-        const PDATransitionKey& key = it->first;
-        const PDATransitionValue& value = it->second;
-
-        // q: 检查当前状态是否有效
-        if (states.find(key.state) == states.end()) {
+        if (!validTransition(it->first, it->second)) {
             return false;
         }
-
-        // a: 检查输入符号是否在输入字母表中
-        if (input_alphabet.find(key.input) == input_alphabet.end() && key.input != '_') {
+    }
+    for (const auto& pair : overridden) {
+        if (!validTransition(pair.first, pair.second)) {
             return false;
         }
+    }
+    
+    return true;
+}
 
-        // X: 检查栈顶符号是否在栈字母表中
-        if (stack_alphabet.find(key.stack_top) == stack_alphabet.end()) {
-            return false;
-        }
+bool PDAContext::validTransition(const PDATransitionKey& key, const PDATransitionValue& value) const {
+    // q: 检查当前状态是否有效
+    if (states.find(key.state) == states.end()) {
+        return false;
+    }
 
-        // q': 检查下一个状态是否在 states 中
-        if (states.find(value.next_state) == states.end()) {
-            return false;
-        }
+    // a: 检查输入符号是否在输入字母表中
+    if (input_alphabet.find(key.input) == input_alphabet.end() && key.input != '_') {
+        return false;
+    }
 
-        // Y: 检查栈操作是否只包含有效的栈符号
-        if (!std::all_of(value.stack_action.begin(), value.stack_action.end(), [this](char c) {
-            return stack_alphabet.find(c) != stack_alphabet.end();
-        })) {
-            return false;
-        }
+    // X: 检查栈顶符号是否在栈字母表中
+    if (stack_alphabet.find(key.stack_top) == stack_alphabet.end()) {
+        return false;
     }
-    
-    return true;
+
+    // q': 检查下一个状态是否在 states 中
+    if (states.find(value.next_state) == states.end()) {
+        return false;
+    }
+
+    // Y: 检查栈操作是否只包含有效的栈符号
+    return std::all_of(value.stack_action.begin(), value.stack_action.end(), [this](char c) {
+        return stack_alphabet.find(c) != stack_alphabet.end();
+    });
 }
 
 /**
@@ -77,7 +83,16 @@ bool PDAContext::addTransition(const std::string& state, const char input_symbol
     PDATransitionKey key(state, input_symbol, stack_top);
     PDATransitionValue value(next_state, stack_action);
 
-    // 插入到 transitions 中
+    // 插入到 transitions 中，覆盖已有的转移时保留它的编号，被覆盖的转移留给非确定性运行
+    auto it = transitions.find(key);
+    if (it == transitions.end()) {
+        value.id = static_cast<int>(transitions.size());
+    } else {
+        value.id = it->second.id;
+        if (it->second.next_state != next_state || it->second.stack_action != stack_action) {
+            overridden.push_back(*it);
+        }
+    }
     transitions[key] = value;
     return true;
 }
@@ -100,7 +115,7 @@ PDAQueryResult PDAContext::getTransition(const std::string& state, const char in
 PDAQueryResult PDAContext::getTransition(const PDATransitionKey& key) const {
     auto it = transitions.find(key);
     if (it != transitions.end() && it->second.next_state != "") {
-        return PDAQueryResult(it->second.next_state, it->second.stack_action);
+        return PDAQueryResult(it->second.next_state, it->second.stack_action, it->second.id);
     } else {
         return PDAQueryResult();  // 返回默认的失败查询结果
     }
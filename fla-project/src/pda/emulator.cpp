@@ -5,25 +5,29 @@
  */
 
 #include "pda/emulator.h"
-#include "pda/tran_kv.h"
 #include "utils/exception.h"
-#include <stack>
+#include "utils/mapped_file.h"
+#include <chrono>
+#include <fcntl.h>
 #include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 
-PDAEmulator::PDAEmulator(const PDAContext& context) : context(context) {
+PDAEmulator::PDAEmulator(const PDAContext& context) {
     if (!context.validate()) {
         throw AutomataStructureException("Emulator using invalid PDA context.");
     }
+    program = std::make_shared<const PDAProgram>(PDAProgram::compile(context));
 }
 
-bool PDAEmulator::run(const std::string& input) {
-    EmulatorState e_state = EmulatorState::NEW;
+PDAEmulator::PDAEmulator(std::shared_ptr<const PDAProgram> program) : program(std::move(program)) {}
 
-    // 初始化状态
-    std::string state = context.start_state;
-    std::stack<char> stack;
-    stack.push(context.stack_start_symbol);
+bool PDAEmulator::run(const std::string& input) {
+    return simulate(input).status == PDARunStatus::ACCEPT;
+}
 
+PDARunResult PDAEmulator::simulate(const std::string& input) {
     int idx = checkSyntaxError(input);
     if (idx != -1) {
         verboseLogError("Input: " + input);
@@ -34,91 +38,288 @@ bool PDAEmulator::run(const std::string& input) {
         verboseLog("Input: " + input);
     }
 
+    PDAMemoryInput source(*program, input.data(), input.size(), input.size(), "input");
+    return execute(source);
+}
+
+PDARunResult PDAEmulator::simulateFile(const std::string& path) {
+    if (path == "-") {
+        PDAStreamInput source(*program, STDIN_FILENO, "<stdin>");
+        return execute(source);
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    // 普通文件直接映射，管道等只能逐块读入
+    if (S_ISREG(st.st_mode)) {
+        ::close(fd);
+        MappedFile file(path);
+        size_t size = file.size();
+        if (size > 0 && file.data()[size - 1] == '\n') {
+            size--;
+        }
+        PDAMemoryInput source(*program, file.data(), size, 0, path);
+        return execute(source);
+    }
+    try {
+        PDAStreamInput source(*program, fd, path);
+        PDARunResult result = execute(source);
+        ::close(fd);
+        return result;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+template <typename Input>
+PDARunResult PDAEmulator::execute(Input& input) {
+    if (nondeterministic) {
+        return executeNondeterministic(input);
+    }
+    if (stack_backend == PDAStackBackend::RUN_LENGTH) {
+        return execute(input, run_length_stack);
+    }
+    return execute(input, stack);
+}
+
+template <typename Input, typename Stack>
+PDARunResult PDAEmulator::execute(Input& input, Stack& stack) {
+    EmulatorState e_state = EmulatorState::NEW;
+    const PDAProgram& prog = *program;
+
+    // 初始化状态
+    int state = prog.getStartState();
+    stack.reset(prog.getStartSymbol());
+
     e_state = EmulatorState::RUNNING;
     verboseLog("==================== RUN ====================");
 
-    int step_cnt = 0;
-    idx = 0;
-
-    while (e_state == EmulatorState::RUNNING) {
-        verboseLogID(state, stack, step_cnt);
+    long long step_cnt = 0;
+    RunDeadline deadline(limits.time_limit_ms);
 
-        std::string next_state;
-        std::string stack_action;
+    // 性能分析：每个转移的计数
+    long long* hits = nullptr;
+    auto started = std::chrono::steady_clock::now();
+    if (profile != nullptr) {
+        profile->reset(program->getRuleNum());
+        hits = profile->transition_hits.data();
+    }
 
-        PDAQueryResult result;
+    while (e_state == EmulatorState::RUNNING) {
+        if (verbose_mode) {
+            verboseLogID(prog.getStateName(state), stack.contents(), step_cnt);
+        }
 
-        if (idx >= input.size() && context.final_states.find(state) != context.final_states.end())  {
+        bool at_end = input.atEnd();
+        if (at_end && prog.isFinal(state)) {
             // 输入被消耗完且目前在终止状态，直接接受
             e_state = EmulatorState::ACCEPT;
             break;
-        } 
+        }
 
         if(stack.empty()) {
             // 栈空了，但是目前还没接受，直接拒绝
             e_state = EmulatorState::REJECT;
             break;
         }
-        
-        if (idx >= input.size()) {
-            // 输入结束，尝试空转移
-            result = context.getTransition(state, '_', stack.top());
-            if (result.success) {
-                next_state = result.next_state;
-                stack_action = result.stack_action;
-                std::cerr << "stack_action: " << stack_action << std::endl;
+
+        if (limits.max_steps != 0 && step_cnt >= limits.max_steps) {
+            e_state = EmulatorState::STEP_LIMIT;
+            break;
+        }
+        if (deadline.expired()) {
+            e_state = EmulatorState::TIME_LIMIT;
+            break;
+        }
+
+        // 有直接读入输入符号的转移时使用它，否则尝试空转移；输入结束后只能空转移
+        int32_t move = prog.lookup(state, at_end ? prog.getInputNum() : prog.encodeInput(input.current()), stack.top());
+        if (move == PDAProgram::NONE) {
+            // 无可用转移
+            e_state = EmulatorState::REJECT;
+            break;
+        }
+        int32_t transition = move >> 1;
+        size_t push_len;
+        const char* push = prog.getPush(transition, push_len);
+        if (move & 1) {
+            input.advance();
+        }
+
+        // 实施转移
+        state = prog.getNextState(transition);
+        stack.replaceTop(push, push_len);
+
+        step_cnt++;
+        if (hits) {
+            hits[transition]++;
+        }
+
+        if (limits.max_memory != 0 && stack.memoryUsed() > limits.max_memory) {
+            e_state = EmulatorState::MEMORY_LIMIT;
+            break;
+        }
+    }
+
+    // 没有读完输入就停下时，剩余的输入也必须合法，与先检查整个输入的结果一致
+    if (e_state != EmulatorState::ACCEPT) {
+        input.finish();
+    }
+
+    if (hits) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        finishProfile(step_cnt, elapsed.count(), stack.getHighWater());
+    }
+
+    PDARunResult result;
+    result.steps = step_cnt;
+    result.state = prog.getStateName(state);
+    result.consumed = input.position();
+    result.stack_high_water = stack.getHighWater();
+    reportEnd(e_state, result);
+    return result;
+}
+
+template <typename Input>
+PDARunResult PDAEmulator::executeNondeterministic(Input& input) {
+    const PDAProgram& prog = *program;
+    PDAGraphStack graph(prog);
+    graph.reset();
+
+    EmulatorState e_state = EmulatorState::RUNNING;
+    RunDeadline deadline(limits.time_limit_ms);
+
+    // 最后一个还有格局的位置上的一个格局，运行结束时报告它
+    PDAGraphStack::Config last = graph.getConfigs().front();
+    size_t consumed = 0;
+
+    while (e_state == EmulatorState::RUNNING) {
+        // 当前位置上的空转移闭包
+        while (graph.step()) {
+            if (limits.max_steps != 0 && graph.getMoves() >= limits.max_steps) {
+                e_state = EmulatorState::STEP_LIMIT;
+            } else if (deadline.expired()) {
+                e_state = EmulatorState::TIME_LIMIT;
+            } else if (limits.max_memory != 0 && graph.memoryUsed() > limits.max_memory) {
+                e_state = EmulatorState::MEMORY_LIMIT;
             } else {
-                // 输入结束, 且无无条件转移, 且不在接受状态中
-                e_state = EmulatorState::REJECT;
-                break;
+                continue;
             }
-        } else {
-            result = context.getTransition(state, input[idx], stack.top());
-            if (result.success) {
-                next_state = result.next_state;
-                stack_action = result.stack_action;
-                idx++;
-            } else {
-                // 没有可用转移，尝试空转移
-                result = context.getTransition(state, '_', stack.top());
-                if (result.success) {
-                    next_state = result.next_state;
-                    stack_action = result.stack_action;
-                } else {
-                    // 无可用转移
-                    e_state = EmulatorState::REJECT;
+            break;
+        }
+        if (e_state != EmulatorState::RUNNING) {
+            break;
+        }
+
+        const std::vector<PDAGraphStack::Config>& configs = graph.getConfigs();
+        if (configs.empty()) {
+            // 所有格局都没有可用的转移
+            e_state = EmulatorState::REJECT;
+            break;
+        }
+        last = configs.front();
+        consumed = graph.getPosition();
+
+        if (input.atEnd()) {
+            // 输入读完时有一个格局在终止状态即接受
+            e_state = EmulatorState::REJECT;
+            for (const auto& config : configs) {
+                if (prog.isFinal(config.state)) {
+                    last = config;
+                    e_state = EmulatorState::ACCEPT;
                     break;
                 }
             }
+            break;
         }
+        graph.shift(prog.encodeInput(input.current()));
+        input.advance();
+    }
 
-        // 实施转移
-        state = next_state;
-        stack.pop();
-        for (int i = stack_action.size() - 1; i >= 0; i--) {
-            stack.push(stack_action[i]);
-        }
-
-        step_cnt++;
+    if (e_state != EmulatorState::ACCEPT) {
+        input.finish();
     }
 
+    PDARunResult result;
+    result.steps = graph.getMoves();
+    result.state = prog.getStateName(last.state);
+    result.consumed = consumed;
+    result.stack_high_water = graph.getHighWater();
+    reportEnd(e_state, result);
+    return result;
+}
+
+void PDAEmulator::reportEnd(EmulatorState e_state, PDARunResult& result) {
     if (e_state == EmulatorState::ACCEPT) {
+        result.status = PDARunStatus::ACCEPT;
         verboseLog("Result: true");
-        verboseLog("==================== END ====================");
-        return true;
     } else if (e_state == EmulatorState::REJECT) {
+        result.status = PDARunStatus::REJECT;
         verboseLog("Result: false");
-        verboseLog("==================== END ====================");
-        return false;
+    } else if (e_state == EmulatorState::STEP_LIMIT) {
+        result.status = PDARunStatus::STEP_LIMIT;
+        verboseLog("Result: step limit reached");
+    } else if (e_state == EmulatorState::TIME_LIMIT) {
+        result.status = PDARunStatus::TIME_LIMIT;
+        verboseLog("Result: time limit reached");
+    } else {
+        result.status = PDARunStatus::MEMORY_LIMIT;
+        verboseLog("Result: memory limit reached");
     }
-
-    return false;
+    verboseLog("==================== END ====================");
 }
 
 void PDAEmulator::setVerboseMode(bool mode) {
     verbose_mode = mode;
 }
 
+void PDAEmulator::setNondeterministic(bool mode) {
+    nondeterministic = mode;
+}
+
+void PDAEmulator::setStackBackend(PDAStackBackend backend) {
+    stack_backend = backend;
+}
+
+void PDAEmulator::setLimits(const RunLimits& run_limits) {
+    limits = run_limits;
+}
+
+void PDAEmulator::setProfile(RunProfile* run_profile) {
+    profile = run_profile;
+}
+
+void PDAEmulator::finishProfile(long long steps, double seconds, size_t stack_high_water) {
+    profile->machine = "pda";
+    profile->steps = steps;
+    profile->seconds = seconds;
+    profile->wildcard_label = "epsilon";
+
+    for (int q = 0; q < program->getStateNum(); q++) {
+        profile->state_names.push_back(program->getStateName(q));
+    }
+
+    // 被覆盖的转移不会在确定性运行中使用，不列出
+    size_t transition_num = static_cast<size_t>(program->getRuleNum());
+    profile->transition_names.resize(transition_num);
+    profile->transition_states.resize(transition_num);
+    profile->wildcard.resize(transition_num);
+    for (int32_t t = 0; t < program->getRuleNum(); t++) {
+        profile->transition_names[t] = program->describeTransition(t);
+        profile->transition_states[t] = program->getSource(t);
+        profile->wildcard[t] = program->isEpsilon(t) ? 1 : 0;
+    }
+    profile->high_water.emplace_back("stack", stack_high_water);
+}
+
 void PDAEmulator::verboseLog(const std::string& message) {
     if (verbose_mode) {
         std::cout << message << std::endl;
@@ -146,15 +347,13 @@ void PDAEmulator::verboseLogSyntaxError(const std::string& input, const int idx)
     }
 }
 
-void PDAEmulator::verboseLogID(const std::string current_state, const std::stack<char>& stack, const int step_cnt) {
+void PDAEmulator::verboseLogID(const std::string current_state, const std::string& stack, const long long step_cnt) {
     if (verbose_mode) {
         std::cout << "Step : " << step_cnt << std::endl;
         std::cout << "State: " << current_state << std::endl;
         std::cout << "Stack: ";
-        std::stack<char> tmp_stack = stack;
-        while (!tmp_stack.empty()) {
-            std::cout << tmp_stack.top() << " ";
-            tmp_stack.pop();
+        for (char symbol : stack) {
+            std::cout << symbol << " ";
         }
         std::cout << "||(Stack Bottom)" << std::endl;
         std::cout << "---------------------------------------------" << std::endl;
@@ -163,7 +362,7 @@ void PDAEmulator::verboseLogID(const std::string current_state, const std::stack
 
 int PDAEmulator::checkSyntaxError(const std::string& input) {
     for (int i = 0; i < input.size(); i++) {
-        if (context.input_alphabet.find(input[i]) == context.input_alphabet.end()) {
+        if (!program->isInputSymbol(input[i])) {
             return i;
         }
     }
@@ -0,0 +1,140 @@
+/**
+ * Implementation of the graph-structured stack.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/graph_stack.h"
+#include <algorithm>
+
+PDAGraphStack::PDAGraphStack(const PDAProgram &program) : program(program) {}
+
+void PDAGraphStack::reset() {
+    nodes.clear();
+    edges = 0;
+    moves = 0;
+    startPosition(0);
+
+    nodes.push_back(Node{program.getStartSymbol(), 0, 1, {nullptr}, {}});
+    edges = 1;
+    high_water = 1;
+    addConfig(program.getStartState(), &nodes.back());
+}
+
+void PDAGraphStack::startPosition(size_t new_position) {
+    for (Node *node : created) {
+        node->pops.clear();
+        node->pops.shrink_to_fit();
+    }
+    created.clear();
+    merged.clear();
+    configs.clear();
+    seen.clear();
+    pending_pops.clear();
+    next_config = 0;
+    position = new_position;
+}
+
+PDAGraphStack::Node *PDAGraphStack::mergedNode(uint64_t key, char symbol) {
+    Node *&node = merged[key];
+    if (node == nullptr) {
+        nodes.push_back(Node{symbol, position, 0, {}, {}});
+        node = &nodes.back();
+        created.push_back(node);
+    }
+    return node;
+}
+
+void PDAGraphStack::addEdge(Node *node, Node *below) {
+    if (std::find(node->below.begin(), node->below.end(), below) != node->below.end()) {
+        return;
+    }
+    if (node->below.empty()) {
+        node->height = below == nullptr ? 1 : below->height + 1;
+        high_water = std::max(high_water, node->height);
+    }
+    node->below.push_back(below);
+    edges++;
+    for (int32_t t : node->pops) {
+        pending_pops.emplace_back(t, below);
+    }
+}
+
+void PDAGraphStack::addConfig(int state, Node *top) {
+    Config config{state, top};
+    if (seen.insert(config).second) {
+        configs.push_back(config);
+    }
+}
+
+void PDAGraphStack::push(int32_t t, Node *below) {
+    moves++;
+    int state = program.getNextState(t);
+    size_t len;
+    const char *symbols = program.getPush(t, len);
+    if (len == 0) {
+        addConfig(state, below);
+        return;
+    }
+
+    // 栈顶以下的符号按 (t, 第几个符号) 合并，键的最低位为 1
+    for (size_t j = 0; j + 1 < len; j++) {
+        Node *node = mergedNode((static_cast<uint64_t>(t) << 32 | j) << 1 | 1, symbols[j]);
+        addEdge(node, below);
+        below = node;
+    }
+    // 栈顶按 (下一状态, 栈顶符号) 合并，键的最低位为 0
+    uint64_t key = (static_cast<uint64_t>(state) << 8 | static_cast<uint8_t>(symbols[len - 1])) << 1;
+    Node *top = mergedNode(key, symbols[len - 1]);
+    addEdge(top, below);
+    addConfig(state, top);
+}
+
+bool PDAGraphStack::step() {
+    if (!pending_pops.empty()) {
+        std::pair<int32_t, Node *> pop = pending_pops.back();
+        pending_pops.pop_back();
+        push(pop.first, pop.second);
+        return true;
+    }
+    if (next_config >= configs.size()) {
+        return false;
+    }
+
+    Config config = configs[next_config++];
+    Node *top = config.top;
+    if (top == nullptr) {
+        return true;
+    }
+    size_t count;
+    const int32_t *ts = program.getMoves(config.state, program.getInputNum(), top->symbol, count);
+    for (size_t i = 0; i < count; i++) {
+        // 先记下这次弹出，之后 top 得到新的 below 时会重做；当前已有的 below 现在就做
+        if (top->position == position) {
+            top->pops.push_back(ts[i]);
+        }
+        size_t below_num = top->below.size();
+        for (size_t k = 0; k < below_num; k++) {
+            push(ts[i], top->below[k]);
+        }
+    }
+    return true;
+}
+
+void PDAGraphStack::shift(int input) {
+    std::vector<Config> from;
+    from.swap(configs);
+    startPosition(position + 1);
+    for (const Config &config : from) {
+        if (config.top == nullptr) {
+            continue;
+        }
+        size_t count;
+        const int32_t *ts = program.getMoves(config.state, input, config.top->symbol, count);
+        for (size_t i = 0; i < count; i++) {
+            for (Node *below : config.top->below) {
+                push(ts[i], below);
+            }
+        }
+    }
+}
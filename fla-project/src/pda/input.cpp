@@ -0,0 +1,99 @@
+/**
+ * Implementation of the PDA input sources.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/input.h"
+#include "utils/exception.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+// 每次检查的内存输入的字节数
+const size_t CHECK_BLOCK = 1 << 16;
+
+InputSyntaxError illegalSymbol(const std::string &name, size_t offset, char ch) {
+    return InputSyntaxError(name + ": '" + std::string(1, ch) + "' at offset " + std::to_string(offset) +
+                            " was not declared in the set of input symbols");
+}
+
+}
+
+PDAMemoryInput::PDAMemoryInput(const PDAProgram &program, const char *data, size_t size, size_t checked,
+                               std::string name)
+    : program(program), data(data), size(size), checked(checked), name(std::move(name)) {}
+
+bool PDAMemoryInput::checkMore() {
+    if (checked >= size) {
+        return false;
+    }
+    size_t end = std::min(size, checked + CHECK_BLOCK);
+    for (size_t i = checked; i < end; i++) {
+        if (!program.isInputSymbol(data[i])) {
+            throw illegalSymbol(name, i, data[i]);
+        }
+    }
+    checked = end;
+    return true;
+}
+
+void PDAMemoryInput::finish() {
+    while (checkMore()) {
+    }
+}
+
+PDAStreamInput::PDAStreamInput(const PDAProgram &program, int fd, std::string name)
+    : program(program), fd(fd), name(std::move(name)), buffer(BUFFER_SIZE) {}
+
+bool PDAStreamInput::refill() {
+    while (!eof) {
+        offset += len;
+        pos = 0;
+        len = 0;
+        if (held_newline) {
+            buffer[len++] = '\n';
+            held_newline = false;
+        }
+
+        ssize_t n;
+        do {
+            n = ::read(fd, buffer.data() + len, buffer.size() - len);
+        } while (n < 0 && errno == EINTR);
+        if (n < 0) {
+            throw std::runtime_error("Failed to read " + name + ": " + std::strerror(errno));
+        }
+        if (n == 0) {
+            // 留下的换行符是输入的最后一个字节，忽略它
+            eof = true;
+            len = 0;
+            return false;
+        }
+        len += static_cast<size_t>(n);
+        if (buffer[len - 1] == '\n') {
+            len--;
+            held_newline = true;
+        }
+
+        for (size_t i = 0; i < len; i++) {
+            if (!program.isInputSymbol(buffer[i])) {
+                throw illegalSymbol(name, offset + i, buffer[i]);
+            }
+        }
+        if (len > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PDAStreamInput::finish() {
+    pos = len;
+    while (refill()) {
+        pos = len;
+    }
+}
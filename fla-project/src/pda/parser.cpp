@@ -6,27 +6,12 @@
 
 #include "pda/parser.h"
 
+#include "utils/mapped_file.h"
 #include "utils/parse_token.h"
-#include <fstream>
-#include <sstream>
 
-#include <algorithm>
 
 
 
-
-std::set<std::string> PDAParser::control_tokens = {
-    "#Q",
-    "#S",
-    "#G",
-    "#q0",
-    "#z0",
-    "#F"
-};
-
-std::regex PDAParser::state_regex = std::regex("[a-zA-Z0-9_]+");
-
-
 /**
  * Parse a PDA configuration file.
  * 
@@ -34,103 +19,75 @@ std::regex PDAParser::state_regex = std::regex("[a-zA-Z0-9_]+");
  * @return The PDA context parsed from the file.
  */
 PDAContext PDAParser::parse(const std::string& filepath) {
-    // 读取文件
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filepath);
-    }
+    // 映射文件，原地切分
+    MappedFile file(filepath);
+    return parseContent(StringView(file.data(), file.size()));
+}
 
+PDAContext PDAParser::parseContent(StringView text) {
     PDAContext context;
 
-    std::string line;
-    int line_idx = 0;
-
-    while (std::getline(file, line)) {
-        // 行预处理
-        linePreprocess(line);
-
-        line_idx++;
+    LineTokenizer tokenizer(text);
+    while (tokenizer.next()) {
         // 解析行
         try {
-            parseLine(line, context);
+            parseLine(tokenizer, context);
         } catch (AutomataSyntaxException& e) {
-            e.setLine(line_idx, line);
-            file.close();
+            e.setLine(tokenizer.lineIndex(), tokenizer.line().str());
             throw e;
         }
     }
 
-    file.close();
-
     return context;
 }
 
-void PDAParser::linePreprocess(std::string& line) {
-    // 去掉注释
-    // 找到 ';' 在字符串中的位置
-    size_t pos = line.find(';');
-    
-    // 如果找到了 ';'，则截取之前的部分
-    if (pos != std::string::npos) {
-        line = line.substr(0, pos); // 截取到 ';' 前的内容
-    }
-    
-    // 去除末尾可能存在的多余空格
-    line.erase(line.find_last_not_of(" \t") + 1);
-}
-
 
 /**
  * Parse a line to PDA context.
  * 
- * @param line The line to parse.
+ * @param tokenizer The tokenizer positioned at the line to parse.
  */
-void PDAParser::parseLine(const std::string& line, PDAContext& context) {
-    
-    // 分割字符串 into tokens
-    std::vector<std::string> tokens;
+void PDAParser::parseLine(const LineTokenizer& tokenizer, PDAContext& context) {
 
-    std::istringstream iss(line);
-    std::string token;
-    while (iss >> token) {
-        tokens.push_back(token);
-    }
+    StringView line = tokenizer.line();
+    size_t token_num = tokenizer.tokenNum();
 
-    if (tokens.size() > 0) {
+    if (token_num > 0) {
         if (line[0] == ' ') {
-            throw AutomataSyntaxException(line, "leading space but not empty");
+            throw AutomataSyntaxException(line.str(), "leading space but not empty");
         }
     } else {
         return;
     }
 
+    StringView tokens[LineTokenizer::MAX_TOKENS];
+    for (size_t i = 0; i < token_num && i < LineTokenizer::MAX_TOKENS; i++) {
+        tokens[i] = tokenizer.token(i);
+    }
+
     // 检查控制符
-    if (control_tokens.find(tokens[0]) == control_tokens.end()) {
+    if (!isControlToken(tokens[0])) {
         // 无可用控制符，此时第一个token不应该以#开头
         if (tokens[0][0] == '#') {
-            throw AutomataSyntaxException(tokens[0], "Start with '#' but not a valid control token.");
+            throw AutomataSyntaxException(tokens[0].str(), "Start with '#' but not a valid control token.");
         }
 
         // 是转移函数
         // 检查tokens的数量是否满足转移函数要求：5个
-        if (tokens.size() != 5) {
-            throw AutomataSyntaxException(line, "Invalid number of tokens for a transition");
+        if (token_num != 5) {
+            throw AutomataSyntaxException(line.str(), "Invalid number of tokens for a transition");
         }
 
-        std::string state, next_state, stack_action;
+        std::string stack_action;
         char input_symbol, stack_top_symbol;
 
         // 检查状态名是否合法
-        if (std::regex_match(tokens[0], state_regex)) {
-            state = tokens[0];
-        } else {
-            throw AutomataSyntaxException(tokens[0], "only [a-zA-Z0-9_]+ allowed");
+        if (!isStateName(tokens[0])) {
+            throw AutomataSyntaxException(tokens[0].str(), "only [a-zA-Z0-9_]+ allowed");
         }
 
-        if (std::regex_match(tokens[3], state_regex)) {
-            next_state = tokens[3];
-        } else {
-            throw AutomataSyntaxException(tokens[3], "only [a-zA-Z0-9_]+ allowed");
+        if (!isStateName(tokens[3])) {
+            throw AutomataSyntaxException(tokens[3].str(), "only [a-zA-Z0-9_]+ allowed");
         }
 
         // 检查输入符号是否合法
@@ -140,7 +97,7 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
                 throw AutomataSyntaxException(std::to_string(input_symbol), "only printable ASCII characters or '_' allowed");
             }
         } else {
-            throw AutomataSyntaxException(tokens[1], "only single character allowed");
+            throw AutomataSyntaxException(tokens[1].str(), "only single character allowed");
         }
 
         // 检查栈顶符号是否合法
@@ -150,14 +107,14 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
                 throw AutomataSyntaxException(std::to_string(stack_top_symbol), "only printable ASCII characters or allowed");
             }
         } else {
-            throw AutomataSyntaxException(tokens[2], "only single character allowed");
+            throw AutomataSyntaxException(tokens[2].str(), "only single character allowed");
         }
 
         // 检查栈操作是否合法
         if (tokens[4] == "_") {
             stack_action = "";
         } else {
-            stack_action = tokens[4];
+            stack_action = tokens[4].str();
             for (char c : stack_action) {
                 if (!isValidSymbol(c)) {
                     throw AutomataSyntaxException(std::to_string(c), "only printable ASCII characters allowed, or ONLY '_' for empty");
@@ -166,16 +123,16 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
         }
 
         // 添加转移函数
-        context.addTransition(state, input_symbol, stack_top_symbol, next_state, stack_action);
+        context.addTransition(tokens[0].str(), input_symbol, stack_top_symbol, tokens[3].str(), stack_action);
 
     } else {
         // 有控制符
-        if (tokens.size() != 3) {
-            throw AutomataSyntaxException(line, "invalid token num");
+        if (token_num != 3) {
+            throw AutomataSyntaxException(line.str(), "invalid token num");
         }
 
         if (tokens[1] != "=") {
-            throw AutomataSyntaxException(line, "missing '='");
+            throw AutomataSyntaxException(line.str(), "missing '='");
         }
 
         if (tokens[0] == "#Q") {
@@ -184,7 +141,7 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
 
             // 检查状态名是否合法
             for (auto state : states) {
-                if (!std::regex_match(state, state_regex)) {
+                if (!isStateName(state)) {
                     throw AutomataSyntaxException(state, "only [a-zA-Z0-9_]+ allowed");
                 }
             }
@@ -218,10 +175,10 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
 
         } else if (tokens[0] == "#q0") {
             // 初始状态
-            std::string start_state = tokens[2];
+            std::string start_state = tokens[2].str();
 
             // 检查初始状态是否合法
-            if (!std::regex_match(start_state, state_regex)) {
+            if (!isStateName(start_state)) {
                 throw AutomataSyntaxException(start_state, "only [a-zA-Z0-9_]+ allowed");
             }
 
@@ -230,7 +187,7 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
         } else if (tokens[0] == "#z0") {
             // 初始栈符号
             if (tokens[2].size() != 1) {
-                throw AutomataSyntaxException(tokens[2], "only single character allowed");
+                throw AutomataSyntaxException(tokens[2].str(), "only single character allowed");
             }
 
             char stack_start_symbol = tokens[2][0];
@@ -249,7 +206,7 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
 
             // 检查终止状态集合是否合法
             for (auto state : final_states) {
-                if (!std::regex_match(state, state_regex)) {
+                if (!isStateName(state)) {
                     throw AutomataSyntaxException(state, "only [a-zA-Z0-9_]+ allowed");
                 }
             }
@@ -261,13 +218,11 @@ void PDAParser::parseLine(const std::string& line, PDAContext& context) {
     
 }
 
+bool PDAParser::isControlToken(StringView token) {
+    return token == "#Q" || token == "#S" || token == "#G" || token == "#q0" || token == "#z0" || token == "#F";
+}
+
 bool PDAParser::isValidSymbol(char c) {
-    // 检查是否是 ASCII 可显示字符
-    if (c >= 32 && c <= 126) {
-        // 排除不符合要求的字符
-        if (c != ' ' && c != ',' && c != ';' && c != '{' && c != '}' && c != '*' && c != '_') {
-            return true;
-        }
-    }
-    return false;
-}
\ No newline at end of file
+    // ASCII 可显示字符，排除 ' ' ',' ';' '{' '}' '*' '_'
+    return hasCharClass(c, CHAR_SYMBOL);
+}
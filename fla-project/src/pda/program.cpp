@@ -0,0 +1,183 @@
+/**
+ * Implementation of the compiled PDA program.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/program.h"
+#include <map>
+#include <unordered_map>
+
+const int32_t PDAProgram::NONE;
+
+namespace {
+
+// compile() 产生的大数组
+struct Arrays {
+    std::vector<int32_t> next_states;
+    std::vector<uint32_t> action_offsets;
+    std::string actions;
+    std::vector<int32_t> sources;
+    std::vector<char> patterns;
+    std::vector<int32_t> table;
+    std::vector<uint64_t> move_keys;
+    std::vector<uint32_t> move_offsets;
+    std::vector<int32_t> moves;
+};
+
+}
+
+PDAProgram PDAProgram::compile(const PDAContext &context) {
+    PDAProgram program;
+    auto arrays = std::make_shared<Arrays>();
+    program.storage = arrays;
+
+    // 1. 状态编号
+    std::unordered_map<std::string, int> state_ids;
+    for (const auto &state : context.states) {
+        state_ids[state] = static_cast<int>(program.state_names.size());
+        program.state_names.push_back(state);
+        program.final_flags.push_back(context.final_states.count(state) ? 1 : 0);
+    }
+    program.start_state = state_ids[context.start_state];
+    program.start_symbol = context.stack_start_symbol;
+
+    // 2. 输入符号和栈符号编号，栈底符号可能是不在栈字母表中的 '_'
+    for (int i = 0; i < 256; i++) {
+        program.input_ids[i] = -1;
+        program.stack_ids[i] = -1;
+    }
+    for (char ch : context.input_alphabet) {
+        program.input_ids[static_cast<uint8_t>(ch)] = static_cast<int16_t>(program.input_symbols.size());
+        program.input_symbols.push_back(ch);
+    }
+    for (char ch : context.stack_alphabet) {
+        program.stack_ids[static_cast<uint8_t>(ch)] = static_cast<int16_t>(program.stack_num++);
+        program.stack_symbols.push_back(ch);
+    }
+    if (program.stack_ids[static_cast<uint8_t>(program.start_symbol)] < 0) {
+        program.stack_ids[static_cast<uint8_t>(program.start_symbol)] = static_cast<int16_t>(program.stack_num++);
+        program.stack_symbols.push_back(program.start_symbol);
+    }
+
+    // 3. 转移内容，按 addTransition() 给出的编号排列，被覆盖的转移排在最后。下一状态为空的转移视为不存在
+    size_t transition_num = context.transitions.size();
+    std::vector<const DeltaMap::value_type *> by_id(transition_num, nullptr);
+    for (const auto &pair : context.transitions) {
+        by_id[pair.second.id] = &pair;
+    }
+    for (const auto &pair : context.overridden) {
+        by_id.push_back(&pair);
+    }
+    program.rule_num = static_cast<int>(transition_num);
+    program.transition_num = static_cast<int>(by_id.size());
+    arrays->next_states.resize(by_id.size(), -1);
+    for (size_t t = 0; t < by_id.size(); t++) {
+        const PDATransitionKey &key = by_id[t]->first;
+        const PDATransitionValue &value = by_id[t]->second;
+        auto it = state_ids.find(value.next_state);
+        if (it != state_ids.end()) {
+            arrays->next_states[t] = it->second;
+        }
+        arrays->action_offsets.push_back(static_cast<uint32_t>(arrays->actions.size()));
+        arrays->actions.append(value.stack_action.rbegin(), value.stack_action.rend());
+        arrays->sources.push_back(state_ids.at(key.state));
+        arrays->patterns.push_back(key.input);
+        arrays->patterns.push_back(key.stack_top);
+    }
+    arrays->action_offsets.push_back(static_cast<uint32_t>(arrays->actions.size()));
+    program.next_states = arrays->next_states.data();
+    program.action_offsets = arrays->action_offsets.data();
+    program.actions = arrays->actions.data();
+    program.sources = arrays->sources.data();
+    program.patterns = arrays->patterns.data();
+
+    // 4. 非确定性运行的转移关系，空转移的输入符号编号为 input_num
+    std::map<uint64_t, std::vector<int32_t>> move_lists;
+    for (size_t t = 0; t < by_id.size(); t++) {
+        const PDATransitionKey &key = by_id[t]->first;
+        int top = program.stack_ids[static_cast<uint8_t>(key.stack_top)];
+        int input = key.input == '_' ? static_cast<int>(program.input_symbols.size())
+                                     : program.input_ids[static_cast<uint8_t>(key.input)];
+        if (arrays->next_states[t] < 0 || top < 0 || input < 0) {
+            continue;
+        }
+        move_lists[program.moveKey(state_ids.at(key.state), input, top)].push_back(static_cast<int32_t>(t));
+    }
+    for (const auto &pair : move_lists) {
+        arrays->move_keys.push_back(pair.first);
+        arrays->move_offsets.push_back(static_cast<uint32_t>(arrays->moves.size()));
+        arrays->moves.insert(arrays->moves.end(), pair.second.begin(), pair.second.end());
+    }
+    arrays->move_offsets.push_back(static_cast<uint32_t>(arrays->moves.size()));
+    program.move_key_num = static_cast<uint32_t>(arrays->move_keys.size());
+    program.move_keys = arrays->move_keys.data();
+    program.move_offsets = arrays->move_offsets.data();
+    program.moves = arrays->moves.data();
+
+    // 5. 展开稠密表，若表项过多则保留 DeltaMap 作为后备
+    size_t input_num = program.input_symbols.size();
+    size_t stack_num = static_cast<size_t>(program.stack_num);
+    size_t entries = program.state_names.size() * (input_num + 1) * stack_num;
+    program.dense = entries <= MAX_DENSE_ENTRIES;
+    if (!program.dense) {
+        program.fallback = context.transitions;
+        return program;
+    }
+    arrays->table.assign(entries, NONE);
+    program.table = arrays->table.data();
+
+    auto entry = [&](int state, size_t input, int top) -> int32_t & {
+        return arrays->table[(state * (input_num + 1) + input) * stack_num + top];
+    };
+
+    // 先填空转移，它对所有输入（包括输入已读完）都适用；再用直接读入输入符号的转移覆盖
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t t = 0; t < transition_num; t++) {
+            const PDATransitionKey &key = by_id[t]->first;
+            int top = program.stack_ids[static_cast<uint8_t>(key.stack_top)];
+            if (arrays->next_states[t] < 0 || top < 0) {
+                continue;
+            }
+            int state = state_ids.at(key.state);
+            int input = program.input_ids[static_cast<uint8_t>(key.input)];
+            int32_t move = static_cast<int32_t>(t) << 1;
+            if (pass == 0 && key.input == '_') {
+                for (size_t i = 0; i <= input_num; i++) {
+                    entry(state, i, top) = move;
+                }
+            } else if (pass == 1 && input >= 0) {
+                entry(state, input, top) = move | 1;
+            }
+        }
+    }
+
+    return program;
+}
+
+int32_t PDAProgram::lookupFallback(int state, int input, char top) const {
+    if (input < getInputNum()) {
+        auto it = fallback.find(PDATransitionKey(state_names[state], input_symbols[input], top));
+        if (it != fallback.end() && it->second.next_state != "") {
+            return (it->second.id << 1) | 1;
+        }
+    }
+    auto it = fallback.find(PDATransitionKey(state_names[state], '_', top));
+    if (it != fallback.end() && it->second.next_state != "") {
+        return it->second.id << 1;
+    }
+    return NONE;
+}
+
+std::string PDAProgram::describeTransition(int32_t transition) const {
+    std::string text = state_names[sources[transition]] + ' ' + patterns[2 * transition] + ' ' +
+                       patterns[2 * transition + 1] + ' ';
+    if (next_states[transition] >= 0) {
+        text += state_names[next_states[transition]];
+    }
+    // 栈操作按压栈顺序保存，还原为源文件中的顺序
+    size_t len;
+    const char *push = getPush(transition, len);
+    std::string action(push, len);
+    return text + ' ' + (action.empty() ? "_" : std::string(action.rbegin(), action.rend()));
+}
@@ -0,0 +1,329 @@
+/**
+ * Precompiled PDA programs (.pdac files).
+ *
+ * 文件是 PDAProgram 在内存中的样子，加载时映射整个文件，各数组直接指向文件中的对应部分。
+ * 整数按本机字节序存放，文件头中的字节序标记不符时拒绝加载。
+ *
+ *   偏移  类型      内容
+ *   0     char[8]   魔数 "FLAPDAPG"
+ *   8     u32       格式版本 PDAProgram::FILE_VERSION
+ *   12    u32       字节序标记 0x01020304
+ *   16    i32       初始状态编号
+ *   20    u32       状态数
+ *   24    u32       输入符号数
+ *   28    u32       栈符号数
+ *   32    u32       转移数（不含被覆盖的转移）
+ *   36    u32       转移数（含被覆盖的转移）
+ *   40    u32       非确定性转移关系的键数
+ *   44    u32       非确定性转移关系的转移数
+ *   48    u32       栈操作的总长度
+ *   52    u8        栈底符号，之后 3 字节填充
+ *   56    u64       状态名的总长度
+ *   64    u64       源文件内容的长度，没有保存源文件时为 0
+ *   72              以下各部分依次存放，每部分的起点按 8 字节对齐：
+ *                   输入符号 char[输入符号数]，栈符号 char[栈符号数]，终止状态标记 char[状态数]，
+ *                   状态名的起点 u32[状态数 + 1] 与状态名，
+ *                   next_states i32[转移数]，action_offsets u32[转移数 + 1]，actions char[栈操作长度]，
+ *                   sources i32[转移数]，patterns char[转移数 * 2]，
+ *                   table i32[状态数 * (输入符号数 + 1) * 栈符号数]，
+ *                   move_keys u64[键数]，move_offsets u32[键数 + 1]，moves i32[转移关系的转移数]，
+ *                   源文件内容 char[源文件长度]
+ *
+ * 各部分的位置完全由文件头决定，文件大小必须与之相符。加载时检查每个转移和表项都在范围内，
+ * 因此损坏的文件不会导致越界访问。
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/program.h"
+#include "utils/mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'L', 'A', 'P', 'D', 'A', 'P', 'G'};
+const uint32_t ENDIAN_TAG = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    int32_t start_state;
+    uint32_t state_num;
+    uint32_t input_num;
+    uint32_t stack_num;
+    uint32_t rule_num;
+    uint32_t transition_num;
+    uint32_t move_key_num;
+    uint32_t move_num;
+    uint32_t actions_size;
+    uint8_t start_symbol;
+    uint8_t padding[3];
+    uint64_t names_size;
+    uint64_t source_size;
+};
+
+static_assert(sizeof(Header) == 72, "unexpected padding in the .pdac header");
+
+/**
+ * Offsets of the sections following the header.
+ */
+struct Layout {
+    uint64_t entries = 0;
+    uint64_t input_symbols, stack_symbols, final_flags, name_offsets, names;
+    uint64_t next_states, action_offsets, actions, sources, patterns, table;
+    uint64_t move_keys, move_offsets, moves, source;
+    uint64_t size;
+
+    // 返回 false 表示文件头中的数量不合理
+    bool compute(const Header &header) {
+        if (header.state_num == 0 || header.start_state < 0 ||
+            static_cast<uint32_t>(header.start_state) >= header.state_num || header.input_num > 256 ||
+            header.stack_num < 1 || header.stack_num > 256 || header.rule_num > header.transition_num ||
+            header.transition_num > (uint32_t(1) << 30) || header.names_size > (uint64_t(1) << 40) ||
+            header.source_size > (uint64_t(1) << 40)) {
+            return false;
+        }
+        entries = static_cast<uint64_t>(header.state_num) * (header.input_num + 1) * header.stack_num;
+        if (entries > PDAProgram::MAX_DENSE_ENTRIES) {
+            return false;
+        }
+
+        uint64_t pos = sizeof(Header);
+        auto section = [&pos](uint64_t bytes) {
+            uint64_t start = (pos + 7) & ~uint64_t(7);
+            pos = start + bytes;
+            return start;
+        };
+        input_symbols = section(header.input_num);
+        stack_symbols = section(header.stack_num);
+        final_flags = section(header.state_num);
+        name_offsets = section((header.state_num + uint64_t(1)) * sizeof(uint32_t));
+        names = section(header.names_size);
+        next_states = section(header.transition_num * sizeof(int32_t));
+        action_offsets = section((header.transition_num + uint64_t(1)) * sizeof(uint32_t));
+        actions = section(header.actions_size);
+        sources = section(header.transition_num * sizeof(int32_t));
+        patterns = section(header.transition_num * uint64_t(2));
+        table = section(entries * sizeof(int32_t));
+        move_keys = section(header.move_key_num * sizeof(uint64_t));
+        move_offsets = section((header.move_key_num + uint64_t(1)) * sizeof(uint32_t));
+        moves = section(header.move_num * sizeof(int32_t));
+        source = section(header.source_size);
+        size = pos;
+        return true;
+    }
+};
+
+}
+
+void PDAProgram::save(const std::string &path, StringView source_text) const {
+    if (!dense) {
+        throw std::runtime_error("Cannot precompile a machine whose transition table is too large to be dense");
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FILE_VERSION;
+    header.endian_tag = ENDIAN_TAG;
+    header.start_state = start_state;
+    header.state_num = static_cast<uint32_t>(state_names.size());
+    header.input_num = static_cast<uint32_t>(input_symbols.size());
+    header.stack_num = static_cast<uint32_t>(stack_num);
+    header.rule_num = static_cast<uint32_t>(rule_num);
+    header.transition_num = static_cast<uint32_t>(transition_num);
+    header.move_key_num = move_key_num;
+    header.move_num = move_offsets[move_key_num];
+    header.actions_size = action_offsets[transition_num];
+    header.start_symbol = static_cast<uint8_t>(start_symbol);
+    header.names_size = 0;
+    header.source_size = source_text.size();
+    for (const auto &name : state_names) {
+        header.names_size += name.size();
+    }
+
+    Layout layout;
+    if (!layout.compute(header)) {
+        throw std::runtime_error("Cannot precompile this machine");
+    }
+
+    std::string out(layout.size, '\0');
+    auto put = [&out](uint64_t offset, const void *data, size_t bytes) {
+        if (bytes > 0) {
+            std::memcpy(&out[offset], data, bytes);
+        }
+    };
+    put(0, &header, sizeof(header));
+    put(layout.input_symbols, input_symbols.data(), input_symbols.size());
+    put(layout.stack_symbols, stack_symbols.data(), stack_symbols.size());
+    put(layout.final_flags, final_flags.data(), final_flags.size());
+    uint32_t offset = 0;
+    for (size_t q = 0; q <= state_names.size(); q++) {
+        put(layout.name_offsets + q * sizeof(uint32_t), &offset, sizeof(offset));
+        if (q < state_names.size()) {
+            put(layout.names + offset, state_names[q].data(), state_names[q].size());
+            offset += static_cast<uint32_t>(state_names[q].size());
+        }
+    }
+    size_t transitions = static_cast<size_t>(transition_num);
+    put(layout.next_states, next_states, transitions * sizeof(int32_t));
+    put(layout.action_offsets, action_offsets, (transitions + 1) * sizeof(uint32_t));
+    put(layout.actions, actions, header.actions_size);
+    put(layout.sources, sources, transitions * sizeof(int32_t));
+    put(layout.patterns, patterns, transitions * 2);
+    put(layout.table, table, layout.entries * sizeof(int32_t));
+    put(layout.move_keys, move_keys, move_key_num * sizeof(uint64_t));
+    put(layout.move_offsets, move_offsets, (move_key_num + size_t(1)) * sizeof(uint32_t));
+    put(layout.moves, moves, header.move_num * sizeof(int32_t));
+    put(layout.source, source_text.data(), source_text.size());
+
+    // 临时文件名带上进程号，多个进程同时写同一个缓存项时互不干扰
+    std::string tmp_path = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), static_cast<std::streamsize>(out.size())) || !file.flush()) {
+            throw std::runtime_error("Failed to write file: " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+std::shared_ptr<const PDAProgram> PDAProgram::load(const std::string &path) {
+    auto file = std::make_shared<MappedFile>(path);
+    const char *data = file->data();
+
+    Header header;
+    if (file->size() < sizeof(Header)) {
+        throw std::runtime_error("Not a precompiled PDA: " + path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a precompiled PDA: " + path);
+    }
+    if (header.version != FILE_VERSION || header.endian_tag != ENDIAN_TAG) {
+        throw std::runtime_error("Unsupported precompiled PDA version, compile it again: " + path);
+    }
+    Layout layout;
+    if (!layout.compute(header) || layout.size != file->size()) {
+        throw std::runtime_error("Corrupted precompiled PDA: " + path);
+    }
+    auto corrupted = [&path]() {
+        return std::runtime_error("Corrupted precompiled PDA: " + path);
+    };
+
+    auto program = std::make_shared<PDAProgram>();
+    program->start_state = header.start_state;
+    program->start_symbol = static_cast<char>(header.start_symbol);
+    program->stack_num = static_cast<int>(header.stack_num);
+    program->rule_num = static_cast<int>(header.rule_num);
+    program->transition_num = static_cast<int>(header.transition_num);
+    program->move_key_num = header.move_key_num;
+    program->dense = true;
+
+    // 符号编号，同一个符号出现两次的文件是损坏的
+    program->input_symbols.assign(data + layout.input_symbols, data + layout.input_symbols + header.input_num);
+    program->stack_symbols.assign(data + layout.stack_symbols, data + layout.stack_symbols + header.stack_num);
+    for (int i = 0; i < 256; i++) {
+        program->input_ids[i] = -1;
+        program->stack_ids[i] = -1;
+    }
+    for (uint32_t i = 0; i < header.input_num; i++) {
+        int16_t &id = program->input_ids[static_cast<uint8_t>(program->input_symbols[i])];
+        if (id >= 0) {
+            throw corrupted();
+        }
+        id = static_cast<int16_t>(i);
+    }
+    for (uint32_t i = 0; i < header.stack_num; i++) {
+        int16_t &id = program->stack_ids[static_cast<uint8_t>(program->stack_symbols[i])];
+        if (id >= 0) {
+            throw corrupted();
+        }
+        id = static_cast<int16_t>(i);
+    }
+    if (program->stack_ids[header.start_symbol] < 0) {
+        throw corrupted();
+    }
+    program->final_flags.assign(data + layout.final_flags, data + layout.final_flags + header.state_num);
+
+    const uint32_t *name_offsets = reinterpret_cast<const uint32_t *>(data + layout.name_offsets);
+    program->state_names.reserve(header.state_num);
+    for (uint32_t q = 0; q < header.state_num; q++) {
+        if (name_offsets[q] > name_offsets[q + 1] || name_offsets[q + 1] > header.names_size) {
+            throw corrupted();
+        }
+        program->state_names.emplace_back(data + layout.names + name_offsets[q], name_offsets[q + 1] - name_offsets[q]);
+    }
+
+    // 运行时直接用这些数组做下标，因此每一项都要在范围内
+    const int32_t *next_states = reinterpret_cast<const int32_t *>(data + layout.next_states);
+    const uint32_t *action_offsets = reinterpret_cast<const uint32_t *>(data + layout.action_offsets);
+    const char *actions = data + layout.actions;
+    const int32_t *sources = reinterpret_cast<const int32_t *>(data + layout.sources);
+    const char *patterns = data + layout.patterns;
+    const int32_t *table = reinterpret_cast<const int32_t *>(data + layout.table);
+    const uint64_t *move_keys = reinterpret_cast<const uint64_t *>(data + layout.move_keys);
+    const uint32_t *move_offsets = reinterpret_cast<const uint32_t *>(data + layout.move_offsets);
+    const int32_t *moves = reinterpret_cast<const int32_t *>(data + layout.moves);
+    int32_t state_num = static_cast<int32_t>(header.state_num);
+    int32_t transition_num = static_cast<int32_t>(header.transition_num);
+
+    if (action_offsets[0] != 0 || action_offsets[header.transition_num] != header.actions_size) {
+        throw corrupted();
+    }
+    for (uint32_t t = 0; t < header.transition_num; t++) {
+        char input = patterns[2 * t];
+        char top = patterns[2 * t + 1];
+        if (next_states[t] < -1 || next_states[t] >= state_num || sources[t] < 0 || sources[t] >= state_num ||
+            action_offsets[t] > action_offsets[t + 1] || (input != '_' && program->encodeInput(input) < 0) ||
+            program->stack_ids[static_cast<uint8_t>(top)] < 0) {
+            throw corrupted();
+        }
+    }
+    for (uint32_t i = 0; i < header.actions_size; i++) {
+        if (program->stack_ids[static_cast<uint8_t>(actions[i])] < 0) {
+            throw corrupted();
+        }
+    }
+    for (uint64_t i = 0; i < layout.entries; i++) {
+        if (table[i] != NONE &&
+            (table[i] < 0 || (table[i] >> 1) >= program->rule_num || next_states[table[i] >> 1] < 0)) {
+            throw corrupted();
+        }
+    }
+    if (move_offsets[0] != 0 || move_offsets[header.move_key_num] != header.move_num) {
+        throw corrupted();
+    }
+    for (uint32_t i = 0; i < header.move_key_num; i++) {
+        if (move_keys[i] >= layout.entries || (i > 0 && move_keys[i] <= move_keys[i - 1]) ||
+            move_offsets[i] > move_offsets[i + 1]) {
+            throw corrupted();
+        }
+    }
+    for (uint32_t i = 0; i < header.move_num; i++) {
+        if (moves[i] < 0 || moves[i] >= transition_num || next_states[moves[i]] < 0) {
+            throw corrupted();
+        }
+    }
+
+    program->next_states = next_states;
+    program->action_offsets = action_offsets;
+    program->actions = actions;
+    program->sources = sources;
+    program->patterns = patterns;
+    program->table = table;
+    program->move_keys = move_keys;
+    program->move_offsets = move_offsets;
+    program->moves = moves;
+    program->source = StringView(data + layout.source, header.source_size);
+    program->storage = file;
+    return program;
+}
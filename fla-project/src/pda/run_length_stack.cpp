@@ -0,0 +1,23 @@
+/**
+ * Implementation of the run-length encoded PDA stack.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/run_length_stack.h"
+
+void PDARunLengthStack::reset(char bottom) {
+    runs.clear();
+    runs.push_back(Run{bottom, 1});
+    depth = 1;
+    high_water = 1;
+}
+
+std::string PDARunLengthStack::contents() const {
+    std::string symbols;
+    symbols.reserve(depth);
+    for (auto it = runs.rbegin(); it != runs.rend(); ++it) {
+        symbols.append(it->count, it->symbol);
+    }
+    return symbols;
+}
@@ -0,0 +1,28 @@
+/**
+ * Implementation of the PDA stack.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "pda/stack.h"
+
+void PDAStack::reset(char bottom) {
+    if (buffer.empty()) {
+        buffer.resize(64);
+    }
+    buffer[0] = bottom;
+    depth = 1;
+    high_water = 1;
+}
+
+void PDAStack::grow(size_t min_size) {
+    size_t size = buffer.size() * 2;
+    if (size < min_size) {
+        size = min_size;
+    }
+    buffer.resize(size);
+}
+
+std::string PDAStack::contents() const {
+    return std::string(buffer.rend() - static_cast<std::ptrdiff_t>(depth), buffer.rend());
+}
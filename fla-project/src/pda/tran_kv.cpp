@@ -44,8 +44,8 @@ PDATransitionValue::PDATransitionValue() : next_state(""), stack_action("") {};
 /**
  * 构造函数：初始化 PDAQueryResult（用于成功返回）
  */
-PDAQueryResult::PDAQueryResult(std::string next_state, std::string stack_action)
-    : next_state(std::move(next_state)), stack_action(std::move(stack_action)), success(true) {}
+PDAQueryResult::PDAQueryResult(std::string next_state, std::string stack_action, int id)
+    : next_state(std::move(next_state)), stack_action(std::move(stack_action)), success(true), id(id) {}
 
 /**
  * 默认构造函数：初始化 PDAQueryResult（用于失败返回）
@@ -0,0 +1,299 @@
+/**
+ * Implementation of the daemon.
+ */
+
+#include "server/daemon.h"
+#include "pda/emulator.h"
+#include "utils/exception.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+bool readFull(int fd, char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::recv(fd, buf, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeFull(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        // 客户端提前断开时不要因 SIGPIPE 退出
+        ssize_t n = ::send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readFrame(int fd, std::string &payload) {
+    unsigned char header[4];
+    if (!readFull(fd, reinterpret_cast<char *>(header), sizeof(header))) {
+        return false;
+    }
+    uint32_t len = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+    if (len > Daemon::MAX_FRAME) {
+        return false;
+    }
+    payload.resize(len);
+    return len == 0 || readFull(fd, &payload[0], len);
+}
+
+bool writeFrame(int fd, const std::string &payload) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    char header[4];
+    for (int i = 0; i < 4; i++) {
+        header[i] = static_cast<char>(len >> (8 * i));
+    }
+    return writeFull(fd, header, sizeof(header)) && writeFull(fd, payload.data(), payload.size());
+}
+
+// 取请求中下一个以换行结尾的字段
+std::string nextField(const std::string &request, size_t &pos) {
+    size_t end = request.find('\n', pos);
+    if (end == std::string::npos) {
+        throw std::invalid_argument("Malformed request");
+    }
+    std::string field = request.substr(pos, end - pos);
+    pos = end + 1;
+    return field;
+}
+
+std::string runPDA(const std::shared_ptr<const PDAProgram> &program, const RunLimits &limits,
+                   const std::string &input) {
+    PDAEmulator emulator(program);
+    emulator.setLimits(limits);
+    switch (emulator.simulate(input).status) {
+    case PDARunStatus::ACCEPT:
+        return "ok\ntrue";
+    case PDARunStatus::REJECT:
+        return "ok\nfalse";
+    case PDARunStatus::STEP_LIMIT:
+        return "step limit\n";
+    case PDARunStatus::TIME_LIMIT:
+        return "time limit\n";
+    default:
+        return "memory limit\n";
+    }
+}
+
+std::string runTM(const std::shared_ptr<const TMProgram> &program, const Daemon::TMConfigurer &configure,
+                  const RunLimits &limits, const std::string &input) {
+    TMEmulator emulator(program);
+    configure(emulator);
+    emulator.setLimits(limits);
+    auto result = emulator.simulate(input);
+    switch (result.status) {
+    case TMRunStatus::NON_HALTING:
+        return "non-halting\n";
+    case TMRunStatus::STEP_LIMIT:
+        return "step limit\n";
+    case TMRunStatus::TIME_LIMIT:
+        return "time limit\n";
+    case TMRunStatus::MEMORY_LIMIT:
+        return "memory limit\n";
+    default:
+        return "ok\n" + result.output;
+    }
+}
+
+}
+
+Daemon::Daemon(const std::string &socket_path, int workers, const RunLimits &limits, TMConfigurer configure)
+    : socket_path(socket_path), workers(workers < 1 ? 1 : workers), limits(limits),
+      configure(std::move(configure)) {}
+
+std::string Daemon::handle(const std::string &request) {
+    try {
+        size_t pos = 0;
+        std::string path = nextField(request, pos);
+        long long max_steps = std::stoll(nextField(request, pos));
+        std::string input = request.substr(pos);
+
+        // 请求只能收紧服务端的步数上限
+        RunLimits run_limits = limits;
+        if (max_steps > 0 && (run_limits.max_steps == 0 || max_steps < run_limits.max_steps)) {
+            run_limits.max_steps = max_steps;
+        }
+
+        CachedMachine machine = cache.get(path);
+        if (machine.tm) {
+            return runTM(machine.tm, configure, run_limits, input);
+        }
+        return runPDA(machine.pda, run_limits, input);
+    } catch (const InputSyntaxError &e) {
+        return "illegal input\n";
+    } catch (const AutomataSyntaxException &e) {
+        return std::string("syntax error\n") + e.what();
+    } catch (const AutomataStructureException &e) {
+        return std::string("syntax error\n") + e.what();
+    } catch (const std::exception &e) {
+        return std::string("error\n") + e.what();
+    }
+}
+
+bool Daemon::serveRequest(int fd) {
+    std::string request;
+    return readFrame(fd, request) && writeFrame(fd, handle(request));
+}
+
+void Daemon::serve() {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+    }
+    // 上次运行留下的套接字文件会使 bind 失败
+    ::unlink(socket_path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd, 128) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(listen_fd);
+        throw std::runtime_error("Failed to listen on " + socket_path + ": " + error);
+    }
+
+    // 工作线程处理完一个请求后把连接交还给主线程，并通过这个管道唤醒它
+    int wake[2];
+    if (::pipe(wake) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(listen_fd);
+        throw std::runtime_error("Failed to create pipe: " + error);
+    }
+    ::fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(wake[1], F_SETFL, O_NONBLOCK);
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<int> queue;          // 有请求到达、等待工作线程的连接
+    std::vector<int> returned;      // 工作线程交还的连接
+    const size_t capacity = static_cast<size_t>(workers) * 4;
+
+    auto worker = [&]() {
+        while (true) {
+            int fd;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return !queue.empty(); });
+                fd = queue.front();
+                queue.pop_front();
+            }
+            if (serveRequest(fd)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                returned.push_back(fd);
+            } else {
+                ::close(fd);
+            }
+            char byte = 0;
+            while (::write(wake[1], &byte, 1) < 0 && errno == EINTR) {
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; i++) {
+        threads.emplace_back(worker);
+    }
+
+    // 主线程等待空闲连接上的下一个请求，工作线程只在处理请求时占用连接，
+    // 因此空闲的客户端不会占住工作线程
+    std::vector<int> idle;
+    std::vector<pollfd> fds;
+    while (true) {
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.insert(idle.end(), returned.begin(), returned.end());
+            returned.clear();
+            full = queue.size() >= capacity;
+        }
+
+        // 队列已满时只等工作线程，新连接留在内核的监听队列中，已有连接上的请求留在套接字中
+        fds.clear();
+        fds.push_back(pollfd{wake[0], POLLIN, 0});
+        if (!full) {
+            fds.push_back(pollfd{listen_fd, POLLIN, 0});
+            for (int fd : idle) {
+                fds.push_back(pollfd{fd, POLLIN, 0});
+            }
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            continue;
+        }
+
+        char buf[256];
+        while (::read(wake[0], buf, sizeof(buf)) > 0) {
+        }
+        if (full) {
+            continue;
+        }
+
+        // 可读的连接（包括已关闭的）交给工作线程，关闭的连接由它发现并关闭
+        std::vector<int> still_idle;
+        size_t dispatched = 0;
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (fds[i].revents != 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                queue.push_back(fds[i].fd);
+                dispatched++;
+            } else {
+                still_idle.push_back(fds[i].fd);
+            }
+        }
+        idle.swap(still_idle);
+        for (size_t i = 0; i < dispatched; i++) {
+            ready.notify_one();
+        }
+
+        if (fds[1].revents != 0) {
+            int fd = ::accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                // 文件描述符用尽等错误是暂时的，稍后重试
+                if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                continue;
+            }
+            // 读写一帧的时间有上限，发送半个请求后停住的客户端不会一直占住工作线程
+            timeval timeout;
+            timeout.tv_sec = IO_TIMEOUT_MS / 1000;
+            timeout.tv_usec = (IO_TIMEOUT_MS % 1000) * 1000;
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            idle.push_back(fd);
+        }
+    }
+}
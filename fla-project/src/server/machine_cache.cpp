@@ -0,0 +1,70 @@
+/**
+ * Implementation of the machine cache.
+ */
+
+#include "server/machine_cache.h"
+#include "pda/emulator.h"
+#include "pda/parser.h"
+#include "tm/emulator.h"
+#include "tm/parser.h"
+#include "utils/mapped_file.h"
+#include "utils/string_view.h"
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+bool endsWith(const std::string &str, const std::string &suffix) {
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+CachedMachine MachineCache::get(const std::string &path) {
+    bool is_tm = endsWith(path, ".tm");
+    bool is_tmc = endsWith(path, ".tmc");
+    bool is_pda = endsWith(path, ".pda");
+    bool is_pdac = endsWith(path, ".pdac");
+    if (!is_tm && !is_tmc && !is_pda && !is_pdac) {
+        throw std::invalid_argument("Unsupported automata type. File must have extension .pda, .pdac, .tm or .tmc");
+    }
+
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    FileStamp stamp{static_cast<uint64_t>(info.st_dev), static_cast<uint64_t>(info.st_ino),
+                    static_cast<uint64_t>(info.st_size), static_cast<int64_t>(info.st_mtim.tv_sec),
+                    static_cast<int64_t>(info.st_mtim.tv_nsec)};
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end() && it->second.stamp == stamp) {
+            return it->second.machine;
+        }
+    }
+
+    // 文件在 stat 之后被改写时，下一次请求的 stat 数据不同，会再读一次
+    CachedMachine machine;
+    if (is_tmc) {
+        machine.tm = TMProgram::load(path);
+    } else if (is_pdac) {
+        machine.pda = PDAProgram::load(path);
+    } else {
+        MappedFile file(path);
+        StringView content(file.data(), file.size());
+        if (is_tm) {
+            machine.tm = TMEmulator(TMParser::parseContent(content)).getProgram();
+        } else {
+            machine.pda = PDAEmulator(PDAParser::parseContent(content)).getProgram();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.size() >= MAX_ENTRIES && entries.find(path) == entries.end()) {
+        entries.clear();
+    }
+    entries[path] = Entry{stamp, machine};
+    return machine;
+}
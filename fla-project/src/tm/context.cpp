@@ -94,12 +94,10 @@ bool TMContext::validate() const {
 }
 
 
-bool TMContext::addTransition(const std::string &state, const std::string& input_chars, const std::string &replace_chars,
-                       const std::vector<TapeDirection> &tape_directions, const std::string &next_state) {
-    TMTransitionKey key(state, input_chars);
-    TMTransitionValue value(next_state, replace_chars, tape_directions);
-
-    transitions.insert(key, value);
+bool TMContext::addTransition(std::string state, std::string input_chars, std::string replace_chars,
+                       const std::vector<TapeDirection> &tape_directions, std::string next_state) {
+    transitions.insert(TMTransitionKey(std::move(state), std::move(input_chars)),
+                       TMTransitionValue(std::move(next_state), std::move(replace_chars), tape_directions));
 
     return true;
 }
@@ -6,120 +6,599 @@
 
 
 #include "tm/emulator.h"
+#include "tm/mapped_tape.h"
+#include "tm/packed_tape.h"
+#include "tm/trace_file.h"
 #include "utils/exception.h"
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 #include <iostream>
+#include <unordered_map>
 
+namespace {
 
-TMEmulator::TMEmulator(const TMContext &context) : context(context) {
+// 宏机器的缓存键：状态、读头在块内的偏移、块的内容（每格一个字节）
+struct MacroKey {
+    int state;
+    int offset;
+    uint64_t block;
+
+    bool operator==(const MacroKey &other) const {
+        return state == other.state && offset == other.offset && block == other.block;
+    }
+};
+
+struct MacroKeyHash {
+    std::size_t operator()(const MacroKey &key) const {
+        uint64_t h = key.block * 0x9E3779B97F4A7C15ULL;
+        h ^= (static_cast<uint64_t>(key.state) << 8 | static_cast<uint64_t>(key.offset)) + (h >> 29);
+        return static_cast<std::size_t>(h * 0xBF58476D1CE4E5B9ULL);
+    }
+};
+
+// 缓存项数上限，超过后清空
+const size_t MACRO_CACHE_LIMIT = 1 << 20;
+
+// 块内最多连续模拟的步数，超过后从中间状态继续，保证块内死循环也能按步推进
+const long long MACRO_INNER_LIMIT = 1 << 16;
+
+}
+
+
+volatile std::sig_atomic_t TMEmulator::stop_requested = 0;
+
+TMEmulator::TMEmulator(const TMContext &context) {
     // XXX: throw exceptions in constructer is not recommended.
     if (!context.validate()) {
         throw AutomataStructureException("Emulator using invalid TM context.");
     }
+    program = std::make_shared<const TMProgram>(TMProgram::compile(context));
 }
 
-std::string TMEmulator::run(const std::string &input) {
-    EmulatorState e_state = EmulatorState::NEW;
+TMEmulator::TMEmulator(std::shared_ptr<const TMProgram> program) : program(std::move(program)) {}
 
-    std::string state = context.start_state;
-    std::vector<TMTape> tapes(context.tape_num);
-    tapes[0].init(input);
+std::string TMEmulator::run(const std::string &input) {
+    return simulate(input).output;
+}
 
+TMRunResult TMEmulator::simulate(const std::string &input) {
     int idx = checkSyntaxError(input);
     if (idx != -1) {
         verboseLogError("Input: " + input);
         verboseLogSyntaxError(input, idx);
         verboseLog("==================== END ====================");
+        tracer.flush();
         throw InputSyntaxError(input);
     } else {
         verboseLog("Input: " + input);
     }
 
-    e_state = EmulatorState::RUNNING;
-    verboseLog("==================== RUN ====================");
-
-    int step_cnt = 0;
-    
-    while (e_state == EmulatorState::RUNNING) {
-        verboseLogID(state, tapes, step_cnt);
+    try {
+        return start(input, nullptr);
+    } catch (...) {
+        tracer.flush();
+        throw;
+    }
+}
 
-        std::string next_state;
-        std::string input_chars;
-        std::string replace_chars;
-        std::vector<TapeDirection> tape_directions;
+TMRunResult TMEmulator::resume(const TMSnapshot &snapshot) {
+    if (snapshot.machine_hash != program->getHash()) {
+        throw std::runtime_error("Snapshot was taken from a different machine");
+    }
+    if (snapshot.tapes.size() != static_cast<size_t>(program->getTapeNum())) {
+        throw std::runtime_error("Snapshot does not match the machine: wrong number of tapes");
+    }
+    if (snapshot.state < 0 || snapshot.state >= program->getStateNum()) {
+        throw std::runtime_error("Snapshot does not match the machine: state " + std::to_string(snapshot.state) +
+                                 " is out of range");
+    }
+    if (snapshot.steps < 0) {
+        throw std::runtime_error("Snapshot does not match the machine: negative step count");
+    }
+    // 格子的内容是符号编号，运行时用来查转移表
+    for (size_t i = 0; i < snapshot.tapes.size(); i++) {
+        for (char id : snapshot.tapes[i].cells) {
+            if (static_cast<uint8_t>(id) >= program->getSymbolNum()) {
+                throw std::runtime_error("Snapshot does not match the machine: tape " + std::to_string(i) +
+                                         " holds a symbol outside the tape alphabet");
+            }
+        }
+    }
+    verboseLog("Resume: step " + std::to_string(snapshot.steps));
+    try {
+        return start(std::string(), &snapshot);
+    } catch (...) {
+        tracer.flush();
+        throw;
+    }
+}
 
-        if (context.final_states.find(state) != context.final_states.end()) {
-            // 已经到达终止状态
-            e_state = EmulatorState::ACCEPT;
+TMRunResult TMEmulator::start(const std::string &input, const TMSnapshot *from) {
+    trace_last_step = -1;
+    trace_prev_state = -1;
+    if (macro_block > 1 && program->getTapeNum() == 1 && !verbose_mode && !detect_loops && limits.max_steps == 0 &&
+        checkpoint_path.empty() && trace_path.empty() && profile == nullptr && from == nullptr) {
+        return executeMacro(input);
+    }
+    if (tape_backend == TMTapeBackend::MAPPED) {
+        return execute<TMMappedTape>(input, from);
+    }
+    if (tape_backend == TMTapeBackend::PACKED) {
+        switch (program->getCellBits()) {
+        case 1:
+            return execute<TMPackedTape<1>>(input, from);
+        case 2:
+            return execute<TMPackedTape<2>>(input, from);
+        case 4:
+            return execute<TMPackedTape<4>>(input, from);
+        default:
             break;
         }
+    }
+    return execute<TMTape>(input, from);
+}
+
+template <typename Tape>
+TMRunResult TMEmulator::execute(const std::string &input, const TMSnapshot *from) {
+    EmulatorState e_state = EmulatorState::NEW;
+
+    const TMProgram &prog = *program;
+    const int tape_num = prog.getTapeNum();
+
+    int state = prog.getStartState();
+    std::vector<Tape> tapes;
+    tapes.reserve(tape_num);
+    for (int i = 0; i < tape_num; i++) {
+        tapes.emplace_back(prog.getBlank());
+        tapes[i].setMemoryLimit(limits.max_memory);
+    }
+
+    long long step_cnt = 0;
+
+    // 纸带 0 上一开始非空白的区间，供循环检测使用
+    int first = 0;
+    int last = std::max(static_cast<int>(input.size()) - 1, 0);
 
-        for (auto& tape: tapes) {
-            input_chars += tape.read();
+    if (from != nullptr) {
+        state = from->state;
+        step_cnt = from->steps;
+        for (int i = 0; i < tape_num; i++) {
+            const auto &image = from->tapes[i];
+            tapes[i].restore(image.cells, image.left, image.head);
         }
+        first = from->tapes[0].left;
+        last = first + static_cast<int>(from->tapes[0].cells.size()) - 1;
+    } else {
+        tapes[0].init(prog.encode(input));
+    }
 
-        auto result = context.getTransition(state,input_chars);
+    // 当前各纸带读头下的符号编号
+    std::vector<char> syms(tape_num);
 
-        if (!result.success) {
-            e_state = EmulatorState::HALT;
-            break;
+    std::unique_ptr<TMLoopDetector<Tape>> detector;
+    if (detect_loops) {
+        detector.reset(new TMLoopDetector<Tape>(prog.getStateNum(), tape_num, first, last));
+    }
+
+    e_state = EmulatorState::RUNNING;
+    verboseLog("==================== RUN ====================");
+
+    RunDeadline deadline(limits.time_limit_ms);
+
+    const bool checkpointing = !checkpoint_path.empty();
+    long long next_checkpoint = checkpoint_interval > 0 ? step_cnt + checkpoint_interval : LLONG_MAX;
+
+    std::unique_ptr<TMTraceRecorder> recorder;
+    if (!trace_path.empty()) {
+        recorder.reset(
+            new TMTraceRecorder(trace_path, takeSnapshot(state, tapes, step_cnt), keyframe_interval > 0));
+    }
+    long long next_keyframe = keyframe_interval > 0 ? step_cnt + keyframe_interval : LLONG_MAX;
+
+    // 性能分析：每个转移的计数，以及各纸带用到的最左和最右的格子
+    long long *hits = nullptr;
+    std::vector<int> head_min(tape_num);
+    std::vector<int> head_max(tape_num);
+    const long long start_step = step_cnt;
+    auto started = std::chrono::steady_clock::now();
+    if (profile != nullptr) {
+        profile->reset(prog.getTransitionNum());
+        hits = profile->transition_hits.data();
+        for (int i = 0; i < tape_num; i++) {
+            int left = 0;
+            std::string cells = tapes[i].getNonBlank(left);
+            head_min[i] = left;
+            head_max[i] = left + static_cast<int>(cells.size()) - 1;
         }
+    }
 
-        for (int i = 0; i < input_chars.size(); i++) {
-            if (result.replace_chars[i] == '*') {
-                replace_chars[i] = input_chars[i];
-            } else {
-                replace_chars[i] = result.replace_chars[i];
+    // verbose 模式、记录轨迹和性能分析时需要逐步进行，不能跳过
+    const bool skip_runs = accelerated && !verbose_mode && !recorder && !hits;
+    
+    try {
+        while (e_state == EmulatorState::RUNNING) {
+            verboseLogID(state, tapes, step_cnt);
+
+            if (prog.isFinal(state)) {
+                // 已经到达终止状态
+                e_state = EmulatorState::ACCEPT;
+                break;
             }
-        }
 
-        for (int i = 0; i < context.tape_num; i++) {
-            tapes[i].write(replace_chars[i]);
-        }
+            if (detector && detector->check(state, tapes, step_cnt)) {
+                e_state = EmulatorState::LOOPING;
+                break;
+            }
+
+            for (int i = 0; i < tape_num; i++) {
+                syms[i] = tapes[i].read();
+            }
 
-        for (int i = 0; i < context.tape_num; i++) {
-            switch(result.tape_directions[i]) {
-            case TapeDirection::LEFT:
-                tapes[i].moveLeft();
+            int8_t sweep = 0;
+            int32_t transition = skip_runs ? prog.lookup(state, syms.data(), sweep) : prog.lookup(state, syms.data());
+
+            if (transition < 0) {
+                e_state = EmulatorState::HALT;
                 break;
-            case TapeDirection::RIGHT:
-                tapes[i].moveRight();
+            }
+
+            if (limits.max_steps != 0 && step_cnt >= limits.max_steps) {
+                e_state = EmulatorState::STEP_LIMIT;
                 break;
-            case TapeDirection::STAY:
+            }
+            if (deadline.expired()) {
+                e_state = EmulatorState::TIME_LIMIT;
                 break;
             }
+
+            if (checkpointing && (step_cnt >= next_checkpoint || stop_requested)) {
+                takeSnapshot(state, tapes, step_cnt).save(checkpoint_path);
+                if (stop_requested) {
+                    stop_requested = 0;
+                    e_state = EmulatorState::INTERRUPTED;
+                    break;
+                }
+                next_checkpoint = step_cnt + checkpoint_interval;
+            }
+
+            if (sweep != 0) {
+                // 同一个表项会一直重复，直到该纸带读到不同的符号，但不超过剩余的步数
+                size_t remaining = limits.max_steps != 0 ? static_cast<size_t>(limits.max_steps - step_cnt) : SIZE_MAX;
+                size_t moved = tapes[std::abs(sweep) - 1].skipRun(sweep > 0 ? 1 : -1, remaining);
+                if (moved > 0) {
+                    step_cnt += static_cast<long long>(moved);
+                    continue;
+                }
+            }
+
+            if (recorder && step_cnt >= next_keyframe) {
+                recorder->keyframe(takeSnapshot(state, tapes, step_cnt));
+                next_keyframe = step_cnt + keyframe_interval;
+            }
+
+            const uint8_t *writes = prog.getWrites(transition);
+            const int8_t *moves = prog.getMoves(transition);
+
+            for (int i = 0; i < tape_num; i++) {
+                if (writes[i] != TMProgram::KEEP) {
+                    tapes[i].write(static_cast<char>(writes[i]));
+                }
+                if (moves[i] < 0) {
+                    tapes[i].moveLeft();
+                } else if (moves[i] > 0) {
+                    tapes[i].moveRight();
+                }
+            }
+            if (recorder) {
+                recorder->step(transition);
+            }
+            if (hits) {
+                hits[transition]++;
+                for (int i = 0; i < tape_num; i++) {
+                    int head = tapes[i].getHead();
+                    head_min[i] = std::min(head_min[i], head);
+                    head_max[i] = std::max(head_max[i], head);
+                }
+            }
+
+            state = prog.getNextState(transition);
+            step_cnt++;
         }
+    } catch (const ResourceLimitException &) {
+        // 纸带超过内存上限，保留停止时的状态
+        e_state = EmulatorState::MEMORY_LIMIT;
+    }
+    if (recorder) {
+        recorder->close();
+    }
+    if (hits) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        finishProfile(step_cnt - start_step, elapsed.count(), head_min, head_max);
+    }
+    verboseLogID(state, tapes, step_cnt, true);
 
-        state = result.next_state;
-        step_cnt++;
+    TMCycle cycle;
+    if (e_state == EmulatorState::LOOPING) {
+        cycle = detector->getCycle();
     }
+    return finish(e_state, state, prog.decode(tapes[0].getAnswer()), step_cnt, cycle);
+}
 
-    if (e_state == EmulatorState::ACCEPT || e_state == EmulatorState::HALT) {
-        auto content = tapes[0].getAnswer();
-        verboseLog("Result: " + content);
-        verboseLog("==================== END ====================");
-        return content;
-    } else {
-        std::string content;
-        verboseLog("Result: " + content);
-        verboseLog("==================== END ====================");
-        return content;
+template <typename Tape>
+TMSnapshot TMEmulator::takeSnapshot(int state, const std::vector<Tape> &tapes, long long step_cnt) const {
+    TMSnapshot snapshot;
+    snapshot.machine_hash = program->getHash();
+    snapshot.state = state;
+    snapshot.steps = step_cnt;
+    for (const auto &tape : tapes) {
+        TMSnapshot::TapeImage image;
+        image.cells = tape.getNonBlank(image.left);
+        image.head = tape.getHead();
+        snapshot.tapes.push_back(std::move(image));
     }
+    return snapshot;
+}
+
+void TMEmulator::finishProfile(long long steps, double seconds, const std::vector<int> &head_min,
+                               const std::vector<int> &head_max) {
+    const TMProgram &prog = *program;
+    profile->machine = "tm";
+    profile->steps = steps;
+    profile->seconds = seconds;
+    profile->wildcard_label = "wildcard";
+    for (int32_t t = 0; t < prog.getTransitionNum(); t++) {
+        profile->transition_names.push_back(prog.describeTransition(t));
+        profile->transition_states.push_back(prog.getSource(t));
+        profile->wildcard.push_back(prog.isWildcard(t) ? 1 : 0);
+    }
+    for (int q = 0; q < prog.getStateNum(); q++) {
+        profile->state_names.push_back(prog.getStateName(q));
+    }
+    for (size_t i = 0; i < head_min.size(); i++) {
+        profile->high_water.emplace_back("tape" + std::to_string(i), static_cast<size_t>(head_max[i] - head_min[i] + 1));
+    }
+}
+
+TMRunResult TMEmulator::finish(EmulatorState e_state, int state, const std::string &output, long long steps,
+                               const TMCycle &cycle) {
+    TMRunResult result;
+    result.output = output;
+    result.steps = steps;
+    result.state = program->getStateName(state);
+
+    switch (e_state) {
+    case EmulatorState::ACCEPT:
+        result.status = TMRunStatus::ACCEPT;
+        verboseLog("Result: " + output);
+        break;
+    case EmulatorState::LOOPING:
+        result.status = TMRunStatus::NON_HALTING;
+        result.cycle = cycle;
+        verboseLog("Result: non-halting, cycle of " + std::to_string(cycle.length) + " steps found at step " +
+                   std::to_string(cycle.found_at));
+        break;
+    case EmulatorState::STEP_LIMIT:
+        result.status = TMRunStatus::STEP_LIMIT;
+        verboseLog("Result: step limit reached");
+        break;
+    case EmulatorState::TIME_LIMIT:
+        result.status = TMRunStatus::TIME_LIMIT;
+        verboseLog("Result: time limit reached");
+        break;
+    case EmulatorState::MEMORY_LIMIT:
+        result.status = TMRunStatus::MEMORY_LIMIT;
+        verboseLog("Result: memory limit reached");
+        break;
+    case EmulatorState::INTERRUPTED:
+        result.status = TMRunStatus::INTERRUPTED;
+        verboseLog("Result: interrupted, snapshot saved");
+        break;
+    default:
+        result.status = TMRunStatus::HALT;
+        verboseLog("Result: " + output);
+        break;
+    }
+    verboseLog("==================== END ====================");
+    tracer.flush();
+    return result;
+}
+
+TMRunResult TMEmulator::executeMacro(const std::string &input) {
+    const TMProgram &prog = *program;
+    const int k = macro_block;
+
+    // 在一个块内模拟的结果
+    struct BlockResult {
+        int state;
+        int offset;             // 离开块时为 -1 或 k，否则停在块内
+        uint64_t block;
+        long long steps;
+        EmulatorState e_state;  // RUNNING 表示离开了块或达到了块内步数上限
+    };
+
+    std::unordered_map<MacroKey, BlockResult, MacroKeyHash> cache;
+
+    auto simulate = [&](const MacroKey &key) {
+        char cells[8];
+        for (int i = 0; i < k; i++) {
+            cells[i] = static_cast<char>(key.block >> (8 * i));
+        }
+
+        BlockResult result = {key.state, key.offset, 0, 0, EmulatorState::RUNNING};
+        while (result.steps < MACRO_INNER_LIMIT) {
+            if (prog.isFinal(result.state)) {
+                result.e_state = EmulatorState::ACCEPT;
+                break;
+            }
+            int32_t transition = prog.lookup(result.state, &cells[result.offset]);
+            if (transition < 0) {
+                result.e_state = EmulatorState::HALT;
+                break;
+            }
+
+            uint8_t write = prog.getWrites(transition)[0];
+            if (write != TMProgram::KEEP) {
+                cells[result.offset] = static_cast<char>(write);
+            }
+            result.offset += prog.getMoves(transition)[0];
+            result.state = prog.getNextState(transition);
+            result.steps++;
+
+            if (result.offset < 0 || result.offset >= k) {
+                break;
+            }
+        }
+
+        for (int i = 0; i < k; i++) {
+            result.block |= static_cast<uint64_t>(static_cast<uint8_t>(cells[i])) << (8 * i);
+        }
+        return result;
+    };
+
+    TMTape tape(prog.getBlank());
+    tape.setMemoryLimit(limits.max_memory);
+    tape.init(prog.encode(input));
+
+    int state = prog.getStartState();
+    int head = 0;
+    long long step_cnt = 0;
+    RunDeadline deadline(limits.time_limit_ms);
+
+    EmulatorState e_state = EmulatorState::RUNNING;
+    verboseLog("==================== RUN ====================");
+
+    try {
+        // 一个宏步可能包含很多步，按包含的步数计入时间检查的间隔
+        long long macro_steps = 1;
+        while (e_state == EmulatorState::RUNNING) {
+            if (deadline.expired(macro_steps)) {
+                e_state = EmulatorState::TIME_LIMIT;
+                break;
+            }
+
+            // 读头所在块的起始位置（向下取整）
+            int base = (head >= 0 ? head / k : -((-head + k - 1) / k)) * k;
+            char *cells = tape.cellsAt(base, k);
+
+            MacroKey key = {state, head - base, 0};
+            for (int i = 0; i < k; i++) {
+                key.block |= static_cast<uint64_t>(static_cast<uint8_t>(cells[i])) << (8 * i);
+            }
+
+            auto it = cache.find(key);
+            if (it == cache.end()) {
+                if (cache.size() >= MACRO_CACHE_LIMIT) {
+                    cache.clear();
+                }
+                it = cache.emplace(key, simulate(key)).first;
+            }
+            const BlockResult &result = it->second;
 
+            for (int i = 0; i < k; i++) {
+                cells[i] = static_cast<char>(result.block >> (8 * i));
+            }
+            state = result.state;
+            step_cnt += result.steps;
+            e_state = result.e_state;
+            macro_steps = std::max(result.steps, 1LL);
+
+            // 从一侧进入、原样从另一侧离开且状态不变时，后面内容相同的块也会被同样地穿过，
+            // 直接跳过它们（只在已分配的缓冲区内跳过）
+            if (e_state == EmulatorState::RUNNING && result.state == key.state && result.block == key.block &&
+                ((key.offset == 0 && result.offset == k) || (key.offset == k - 1 && result.offset == -1))) {
+                int dir = result.offset == k ? 1 : -1;
+                int left = tape.getLeftIdx();
+                int right = left + static_cast<int>(tape.getTape().size());
+                for (int next = base + dir * k; next >= left && next + k <= right; next += dir * k) {
+                    if (std::memcmp(tape.cellsAt(next, k), cells, k) != 0) {
+                        break;
+                    }
+                    // 跳过的块可能很多，逐块计入时间检查，超时时停在已经穿过的块之后
+                    if (deadline.expired(macro_steps)) {
+                        e_state = EmulatorState::TIME_LIMIT;
+                        break;
+                    }
+                    base = next;
+                    step_cnt += result.steps;
+                }
+            }
+            head = base + result.offset;
+        }
+    } catch (const ResourceLimitException &) {
+        e_state = EmulatorState::MEMORY_LIMIT;
+    }
 
+    return finish(e_state, state, prog.decode(tape.getAnswer()), step_cnt);
 }
 
 void TMEmulator::setVerboseMode(bool mode) {
     verbose_mode = mode;
 }
 
+void TMEmulator::setTraceOptions(const TMTraceOptions &options) {
+    trace_options = options;
+    if (trace_options.every < 1) {
+        trace_options.every = 1;
+    }
+}
+
+void TMEmulator::setTapeBackend(TMTapeBackend backend) {
+    tape_backend = backend;
+}
+
+void TMEmulator::setTapeMemoryLimit(size_t bytes) {
+    limits.max_memory = bytes;
+}
+
+void TMEmulator::setLimits(const RunLimits &run_limits) {
+    limits = run_limits;
+}
+
+void TMEmulator::setAccelerated(bool mode) {
+    accelerated = mode;
+}
+
+void TMEmulator::setMacroBlock(int k) {
+    macro_block = k < 0 ? 0 : (k > 8 ? 8 : k);
+}
+
+void TMEmulator::setTraceFile(const std::string &path, long long interval) {
+    trace_path = path;
+    keyframe_interval = interval < 0 ? 0 : interval;
+}
+
+void TMEmulator::setProfile(RunProfile *run_profile) {
+    profile = run_profile;
+}
+
+void TMEmulator::setLoopDetection(bool mode) {
+    detect_loops = mode;
+}
+
+void TMEmulator::setCheckpoint(const std::string &path, long long interval) {
+    checkpoint_path = path;
+    checkpoint_interval = interval;
+}
+
+void TMEmulator::requestStop() {
+    stop_requested = 1;
+}
+
 void TMEmulator::verboseLog(const std::string &message) {
     if (verbose_mode) {
-        std::cout << message << std::endl;
+        tracer.line(message);
     }
 }
 
 void TMEmulator::verboseLogError(const std::string &message) {
     if (verbose_mode) {
+        // 保持与标准输出的先后顺序
+        tracer.flush();
         std::cerr << message << std::endl;
     }
 }
@@ -139,73 +618,57 @@ void TMEmulator::verboseLogSyntaxError(const std::string& input, const int idx)
     }
 }
 
-void TMEmulator::verboseLogID(const std::string &current_state, const std::vector<TMTape> &tapes, const int step_cnt) {
-    if (verbose_mode) {
-        std::cout << "Step   : " << step_cnt << std::endl;
-        std::cout << "State  : " << current_state << std::endl;
-        for (int i = 0; i < tapes.size(); i++) {
-            std::string index;
-            std::string tape;
-            std::string head;
-
-            std::string content;
-            int idx = 0;
-
-            content = tapes[i].getNonBlank(idx);
-
-            for (auto ch: content) {
-                std::string idx_str = std::to_string(abs(idx));
-                idx_str += ' ';
-                std::string char_str;
-                char_str += ch;
-                while (char_str.length() < idx_str.length()) {
-                    char_str += ' ';
-                }
-                index += idx_str;
-                tape += char_str;
-                std::string head_str(idx_str.length(), ' ');
-                if (tapes[i].getHead() == idx) {
-                    head_str[0] = '^';
-                }
-                head += head_str;
-                idx++;
-            }
-
-            std::string idx_head;
-            std::string tape_head;
-            std::string head_head;
-
-            idx_head += "Index" + std::to_string(i);
-            tape_head += "Tape" + std::to_string(i);
-            head_head += "Head" + std::to_string(i);
-
-            while (idx_head.length() < 7) {
-                idx_head += ' ';
-            }
-            while (tape_head.length() < 7) {
-                tape_head += ' ';
+template <typename Tape>
+void TMEmulator::verboseLogID(const int current_state, const std::vector<Tape> &tapes, const long long step_cnt,
+                              bool last) {
+    if (!verbose_mode) {
+        return;
+    }
+    bool changed = current_state != trace_prev_state;
+    trace_prev_state = current_state;
+    if (last ? trace_last_step == step_cnt
+             : step_cnt % trace_options.every != 0 || (trace_options.state_changes && !changed)) {
+        return;
+    }
+    trace_last_step = step_cnt;
+
+    tracer.beginConfiguration(step_cnt, program->getStateName(current_state));
+    for (size_t i = 0; i < tapes.size(); i++) {
+        const Tape &tape = tapes[i];
+        int head = tape.getHead();
+        int left = 0;
+        std::string ids;
+        if (trace_options.window > 0) {
+            // 窗口内去掉两端的空白，但不越过读头
+            int w = trace_options.window;
+            ids = tape.getCells(head - w, 2 * w + 1);
+            size_t begin = 0;
+            size_t end = ids.size();
+            char blank = program->getBlank();
+            while (begin < static_cast<size_t>(w) && ids[begin] == blank) {
+                begin++;
             }
-            while (head_head.length() < 7) {
-                head_head += ' ';
+            while (end > static_cast<size_t>(w) + 1 && ids[end - 1] == blank) {
+                end--;
             }
-
-            index = idx_head + ": " + index;
-            tape = tape_head + ": " + tape;
-            head = head_head + ": " + head;
-
-            std::cout << index << std::endl;
-            std::cout << tape << std::endl;
-            std::cout << head << std::endl;
-
+            ids = ids.substr(begin, end - begin);
+            left = head - w + static_cast<int>(begin);
+        } else {
+            ids = tape.getNonBlank(left);
         }
 
-        std::cout << "---------------------------------------------" << std::endl;
+        trace_cells.resize(ids.size());
+        for (size_t j = 0; j < ids.size(); j++) {
+            trace_cells[j] = program->decodeSymbol(ids[j]);
+        }
+        tracer.tape(static_cast<int>(i), trace_cells.data(), trace_cells.size(), left, head);
     }
+    tracer.endConfiguration();
 }
 
 int TMEmulator::checkSyntaxError(const std::string &input) {
     for (int i = 0; i < input.size(); i++) {
-        if (context.input_alphabet.find(input[i]) == context.input_alphabet.end()) {
+        if (!program->isInputSymbol(input[i])) {
             return i;
         }
     }
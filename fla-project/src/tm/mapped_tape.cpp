@@ -0,0 +1,210 @@
+/**
+ * Implementation of the mmap backed tape.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/mapped_tape.h"
+#include "tm/scan.h"
+#include "utils/exception.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const size_t TMMappedTape::CHUNK;
+const size_t TMMappedTape::DEFAULT_RESERVE;
+
+namespace {
+
+size_t pageSize() {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+}
+
+size_t roundUp(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) / unit * unit;
+}
+
+}
+
+TMMappedTape::TMMappedTape(char blank_char) : blank(blank_char) {
+    reserve(DEFAULT_RESERVE);
+    init("");
+}
+
+TMMappedTape::TMMappedTape(TMMappedTape &&other) noexcept
+    : base(other.base), reserved(other.reserved), lo(other.lo), hi(other.hi), cell(other.cell),
+      origin(other.origin), blank(other.blank), memory_limit(other.memory_limit) {
+    other.base = nullptr;
+    other.reserved = 0;
+}
+
+TMMappedTape& TMMappedTape::operator=(TMMappedTape &&other) noexcept {
+    if (this != &other) {
+        release();
+        base = other.base;
+        reserved = other.reserved;
+        lo = other.lo;
+        hi = other.hi;
+        cell = other.cell;
+        origin = other.origin;
+        blank = other.blank;
+        memory_limit = other.memory_limit;
+        other.base = nullptr;
+        other.reserved = 0;
+    }
+    return *this;
+}
+
+TMMappedTape::~TMMappedTape() {
+    release();
+}
+
+void TMMappedTape::reserve(size_t per_side) {
+    per_side = roundUp(per_side, CHUNK);
+    void *addr = mmap(nullptr, per_side * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Failed to reserve address space for the tape");
+    }
+    base = static_cast<char *>(addr);
+    reserved = per_side * 2;
+    origin = base + per_side;
+    lo = hi = cell = origin;
+}
+
+void TMMappedTape::release() {
+    if (base != nullptr) {
+        munmap(base, reserved);
+        base = nullptr;
+        reserved = 0;
+    }
+}
+
+void TMMappedTape::commit(char *from, char *to) {
+    size_t bytes = static_cast<size_t>(to - from);
+    if (memory_limit != 0 && static_cast<size_t>(hi - lo) + bytes > memory_limit) {
+        throw ResourceLimitException("Tape memory limit exceeded: " + std::to_string(memory_limit) + " bytes");
+    }
+    if (from < base || to > base + reserved) {
+        throw ResourceLimitException("Tape address space exhausted");
+    }
+    if (mprotect(from, bytes, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error("Failed to commit tape memory");
+    }
+
+    // 匿名映射的新页内容为 0，空白符不为 0 时需要填充
+    if (blank != 0) {
+        std::memset(from, blank, bytes);
+    }
+
+    lo = std::min(lo, from);
+    hi = std::max(hi, to);
+}
+
+size_t TMMappedTape::chunkSize() const {
+    if (memory_limit == 0) {
+        return CHUNK;
+    }
+    // 上限较小时减小每次提交的粒度，但至少一页
+    return std::max(pageSize(), std::min(CHUNK, roundUp(memory_limit / 8, pageSize())));
+}
+
+size_t TMMappedTape::growthSize() const {
+    if (memory_limit == 0) {
+        return chunkSize();
+    }
+    // 接近上限时只提交到上限为止的整页，已经没有整页可提交时才报错
+    size_t committed = static_cast<size_t>(hi - lo);
+    size_t left = committed < memory_limit ? (memory_limit - committed) / pageSize() * pageSize() : 0;
+    if (left == 0) {
+        throw ResourceLimitException("Tape memory limit exceeded: " + std::to_string(memory_limit) + " bytes");
+    }
+    return std::min(chunkSize(), left);
+}
+
+void TMMappedTape::growLeft() {
+    commit(lo - growthSize(), lo);
+}
+
+void TMMappedTape::growRight() {
+    commit(hi, hi + growthSize());
+}
+
+void TMMappedTape::setMemoryLimit(size_t bytes) {
+    memory_limit = bytes;
+    release();
+    reserve(bytes == 0 ? DEFAULT_RESERVE : roundUp(bytes, CHUNK) + CHUNK);
+    init("");
+}
+
+void TMMappedTape::init(const std::string &init_string) {
+    // 重新映射，丢弃之前提交的内存
+    size_t per_side = reserved / 2;
+    release();
+    reserve(per_side);
+
+    commit(origin, origin + roundUp(std::max<size_t>(init_string.size(), 1), chunkSize()));
+    std::memcpy(origin, init_string.data(), init_string.size());
+    cell = origin;
+}
+
+void TMMappedTape::restore(const std::string &content, int left, int head) {
+    // 内容放在保留区间的中间，移动原点使其位于 left
+    init(content);
+    origin -= left;
+    cell = origin + head;
+}
+
+size_t TMMappedTape::skipRun(int dir, size_t max) {
+    char ch = *cell;
+    size_t len;
+    size_t n;
+
+    // 只在已提交的区间内跳过
+    if (dir > 0) {
+        len = std::min<size_t>(hi - 1 - cell, max);
+        n = countRunForward(cell + 1, len, ch);
+        n = n < len ? n + 1 : n;
+        cell += n;
+    } else {
+        len = std::min<size_t>(cell - lo, max);
+        n = countRunBackward(cell - 1, len, ch);
+        n = n < len ? n + 1 : n;
+        cell -= n;
+    }
+    return n;
+}
+
+std::string TMMappedTape::getAnswer() const {
+    // 已提交的区间按块分配，大部分是空白，按字扫描跳过
+    size_t size = static_cast<size_t>(hi - lo);
+    const char *first = lo + countRunForward(lo, size, blank);
+    if (first == hi) {
+        return std::string();
+    }
+    const char *last = hi - 1 - countRunBackward(hi - 1, size, blank);
+
+    return std::string(first, last + 1);
+}
+
+std::string TMMappedTape::getNonBlank(int &idx) const {
+    // 最左、最右的非空白格子，但不越过读头
+    const char *left = lo + countRunForward(lo, static_cast<size_t>(cell - lo), blank);
+    const char *right = hi - 1 - countRunBackward(hi - 1, static_cast<size_t>(hi - 1 - cell), blank);
+
+    idx = static_cast<int>(left - origin);
+
+    return std::string(left, right + 1);
+}
+
+std::string TMMappedTape::getCells(int pos, int len) const {
+    std::string content(len, blank);
+    long begin = std::max<long>(pos, lo - origin);
+    long end = std::min<long>(static_cast<long>(pos) + len, hi - origin);
+    for (long i = begin; i < end; i++) {
+        content[i - pos] = origin[i];
+    }
+    return content;
+}
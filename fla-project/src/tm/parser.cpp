@@ -4,123 +4,86 @@
 
 #include "tm/parser.h"
 
+#include "utils/mapped_file.h"
 #include "utils/parse_token.h"
-#include <fstream>
-#include <sstream>
 
-#include <algorithm>
-
-
-std::set<std::string> TMParser::control_tokens = {"#Q", "#S", "#G", "#q0", "#B", "#N", "#F"};
-
-std::regex TMParser::state_regex = std::regex("[a-zA-Z0-9_]+");
 
 TMContext TMParser::parse(const std::string& filepath) {
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filepath);
-    }
+    MappedFile file(filepath);
+    return parseContent(StringView(file.data(), file.size()));
+}
 
+TMContext TMParser::parseContent(StringView text) {
     TMContext context;
 
-    std::string line;
-    int line_idx = 0;
-
-    while (std::getline(file,line)) {
-        linePreprocess(line);
-
-        line_idx++;
-
+    LineTokenizer tokenizer(text);
+    while (tokenizer.next()) {
         try {
-            parseLine(line, context);
+            parseLine(tokenizer, context);
         } catch (AutomataSyntaxException& e) {
-            e.setLine(line_idx, line);
-            file.close();
+            e.setLine(tokenizer.lineIndex(), tokenizer.line().str());
             throw e;
         }
     }
 
-    file.close();
-
     return context;
 }
 
-void TMParser::linePreprocess(std::string& line) {
-    // 目的是去掉注释
-    // 找到 ';' 在字符串中的位置
-    size_t pos = line.find(';');
+void TMParser::parseLine(const LineTokenizer& tokenizer, TMContext& context) {
 
-    if (pos != std::string::npos) {
-        line = line.substr(0, pos);
-    }
-
-    // 去除末尾可能存在的多余空格
-    line.erase(line.find_last_not_of(" \t") + 1);
-}
+    StringView line = tokenizer.line();
+    size_t token_num = tokenizer.tokenNum();
 
-void TMParser::parseLine(const std::string& line, TMContext& context) {
-
-    std::vector<std::string> tokens;
-
-    std::istringstream iss(line);
-    std::string token;
-    while (iss >> token) {
-        tokens.push_back(token);
-    }
-
-    if (tokens.size() > 0) {
+    if (token_num > 0) {
         if (line[0] == ' ') {
-            throw AutomataSyntaxException(line, "starts with space but not empty");
+            throw AutomataSyntaxException(line.str(), "starts with space but not empty");
         }
     } else {
         return;
     }
 
+    StringView tokens[LineTokenizer::MAX_TOKENS];
+    for (size_t i = 0; i < token_num && i < LineTokenizer::MAX_TOKENS; i++) {
+        tokens[i] = tokenizer.token(i);
+    }
+
     char blank_default = '_';
 
     // 检查是否是控制符号
-    if (control_tokens.find(tokens[0]) == control_tokens.end()) {
+    if (!isControlToken(tokens[0])) {
         // 无可用控制服，此时第一个token不应该以#开头
         if (tokens[0][0] == '#') {
-            throw AutomataSyntaxException(tokens[0], "starts with '#' but not a valid control token.");
+            throw AutomataSyntaxException(tokens[0].str(), "starts with '#' but not a valid control token.");
         }
 
         // TODO: 处理转移函数
-        if (tokens.size() != 5) {
-            throw AutomataSyntaxException(line, "invalid number of tokens for a transition");
+        if (token_num != 5) {
+            throw AutomataSyntaxException(line.str(), "invalid number of tokens for a transition");
         }
 
-        std::string state, next_state, input_chars, replace_chars;
         std::vector<TapeDirection> tape_directions;
 
-        if (std::regex_match(tokens[0], state_regex)) {
-            state = tokens[0];
-        } else  {
-            throw AutomataSyntaxException(tokens[0], "only [a-zA-Z0-9_]+ allowed");
+        if (!isStateName(tokens[0])) {
+            throw AutomataSyntaxException(tokens[0].str(), "only [a-zA-Z0-9_]+ allowed");
         }
 
-        if (std::regex_match(tokens[4], state_regex)) {
-            next_state = tokens[4];
-        } else {
-            throw AutomataSyntaxException(tokens[0], "only [a-zA-Z0-9_]+ allowed");
+        if (!isStateName(tokens[4])) {
+            throw AutomataSyntaxException(tokens[0].str(), "only [a-zA-Z0-9_]+ allowed");
         }
 
         for (auto ch : tokens[1]) {
-            if (ch == '*' || ch == blank_default || isValidSymbol(ch)) {
-                input_chars += ch;
-            } else {
-                throw AutomataSyntaxException(tokens[1], "found invalid symbols");
+            if (!(ch == '*' || ch == blank_default || isValidSymbol(ch))) {
+                throw AutomataSyntaxException(tokens[1].str(), "found invalid symbols");
             }
         }
 
         for (auto ch : tokens[2]) {
-            if (ch == '*' || ch == blank_default || isValidSymbol(ch)) {
-                replace_chars += ch;
-            } else {
-                throw AutomataSyntaxException(tokens[2], "found invalid symbols");
+            if (!(ch == '*' || ch == blank_default || isValidSymbol(ch))) {
+                throw AutomataSyntaxException(tokens[2].str(), "found invalid symbols");
             }
         }
 
+        tape_directions.reserve(tokens[3].size());
         for (auto ch : tokens[3]) {
             switch (ch) {
             case 'l':
@@ -133,19 +96,19 @@ void TMParser::parseLine(const std::string& line, TMContext& context) {
                 tape_directions.push_back(TapeDirection::STAY);
                 break;
             default:
-                throw AutomataSyntaxException(tokens[3], "only 'lr*' allowed in tape directions");
+                throw AutomataSyntaxException(tokens[3].str(), "only 'lr*' allowed in tape directions");
             }
         }
 
-        context.addTransition(state, input_chars, replace_chars, tape_directions, next_state);
+        context.addTransition(tokens[0].str(), tokens[1].str(), tokens[2].str(), tape_directions, tokens[4].str());
 
     } else {
-        if (tokens.size() != 3) {
-            throw AutomataSyntaxException(line, "invalid token num");
+        if (token_num != 3) {
+            throw AutomataSyntaxException(line.str(), "invalid token num");
         }
 
         if (tokens[1] != "=") {
-            throw AutomataSyntaxException(line, "missing '='");
+            throw AutomataSyntaxException(line.str(), "missing '='");
         }
 
         if (tokens[0] == "#Q") {
@@ -154,7 +117,7 @@ void TMParser::parseLine(const std::string& line, TMContext& context) {
 
             // 检查状态名是否合法
             for (auto state : states) {
-                if (!std::regex_match(state, state_regex)) {
+                if (!isStateName(state)) {
                     throw AutomataSyntaxException(state, "only [a-zA-Z0-9_]+ allowed");
                 }
             }
@@ -188,10 +151,10 @@ void TMParser::parseLine(const std::string& line, TMContext& context) {
 
         } else if (tokens[0] == "#q0") {
             // 初始状态
-            std::string start_state = tokens[2];
+            std::string start_state = tokens[2].str();
 
             // 检查初始状态是否合法
-            if (!std::regex_match(start_state, state_regex)) {
+            if (!isStateName(start_state)) {
                 throw AutomataSyntaxException(start_state, "only [a-zA-Z0-9_]+ allowed");
             }
 
@@ -211,7 +174,7 @@ void TMParser::parseLine(const std::string& line, TMContext& context) {
 
             // 检查终止状态集合是否合法
             for (auto state : final_states) {
-                if (!std::regex_match(state, state_regex)) {
+                if (!isStateName(state)) {
                     throw AutomataSyntaxException(state, "only [a-zA-Z0-9_]+ allowed");
                 }
             }
@@ -220,28 +183,27 @@ void TMParser::parseLine(const std::string& line, TMContext& context) {
 
         } else if (tokens[0] == "#N") {
             try {
-                int number = std::stoi(tokens[2]);
+                int number = std::stoi(tokens[2].str());
                 if (number < 1) {
-                    throw AutomataSyntaxException(tokens[2], "require tape num > 0");
+                    throw AutomataSyntaxException(tokens[2].str(), "require tape num > 0");
                 }
                 context.tape_num = number;
             } catch (const std::invalid_argument &e) {
-                throw AutomataSyntaxException(tokens[2], "not a valid number");
+                throw AutomataSyntaxException(tokens[2].str(), "not a valid number");
             } catch (const std::out_of_range &e) {
-                throw AutomataSyntaxException(tokens[2], "number out of range");
+                throw AutomataSyntaxException(tokens[2].str(), "number out of range");
             }
 
         }
     }
 }
 
+bool TMParser::isControlToken(StringView token) {
+    return token == "#Q" || token == "#S" || token == "#G" || token == "#q0" || token == "#B" || token == "#N" ||
+           token == "#F";
+}
+
 bool TMParser::isValidSymbol(char c) {
-    // 检查是否是 ASCII 可显示字符
-    if (c >= 32 && c <= 126) {
-        // 排除不符合要求的字符
-        if (c != ' ' && c != ',' && c != ';' && c != '{' && c != '}' && c != '*' && c != '_') {
-            return true;
-        }
-    }
-    return false;
-}
\ No newline at end of file
+    // ASCII 可显示字符，排除 ' ' ',' ';' '{' '}' '*' '_'
+    return hasCharClass(c, CHAR_SYMBOL);
+}
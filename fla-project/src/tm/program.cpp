@@ -0,0 +1,266 @@
+/**
+ * Implementation of the compiled TM program.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/program.h"
+#include "utils/hash.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+// compile() 产生的大数组
+struct Arrays {
+    std::vector<int32_t> next_states;
+    std::vector<uint8_t> writes;
+    std::vector<int8_t> moves;
+    std::vector<int32_t> sources;
+    std::vector<char> patterns;
+    std::vector<int32_t> table;
+    std::vector<int8_t> sweeps;
+};
+
+// 带长度前缀，避免相邻字段拼接后产生歧义
+void hashString(uint64_t &hash, const std::string &str) {
+    uint64_t len = str.size();
+    fnv1a(hash, reinterpret_cast<const char *>(&len), sizeof(len));
+    fnv1a(hash, str.data(), str.size());
+}
+
+}
+
+TMProgram TMProgram::compile(const TMContext &context) {
+    TMProgram program;
+    auto arrays = std::make_shared<Arrays>();
+    program.storage = arrays;
+
+    program.tape_num = context.tape_num;
+
+    // 1. 状态编号
+    std::unordered_map<std::string, int> state_ids;
+    for (const auto &state : context.states) {
+        state_ids[state] = static_cast<int>(program.state_names.size());
+        program.state_names.push_back(state);
+        program.final_flags.push_back(context.final_states.count(state) ? 1 : 0);
+    }
+    program.start_state = state_ids[context.start_state];
+
+    // 2. 纸带符号编号
+    for (int i = 0; i < 256; i++) {
+        program.encode_map[i] = -1;
+        program.input_flags[i] = 0;
+    }
+    for (char ch : context.tape_alphabet) {
+        program.encode_map[static_cast<uint8_t>(ch)] = static_cast<int16_t>(program.symbols.size());
+        program.symbols.push_back(ch);
+    }
+    for (char ch : context.input_alphabet) {
+        program.input_flags[static_cast<uint8_t>(ch)] = 1;
+    }
+    program.symbol_num = static_cast<int>(program.symbols.size());
+    program.blank = static_cast<uint8_t>(program.encode_map[static_cast<uint8_t>(context.blank_char)]);
+
+    // 3. 转移编号，按照插入顺序
+    const TranMap &tm_map = context.transitions.getMap();
+    size_t transition_num = tm_map.size();
+    program.transition_num = static_cast<int>(transition_num);
+    arrays->next_states.resize(transition_num);
+    arrays->writes.resize(transition_num * program.tape_num);
+    arrays->moves.resize(transition_num * program.tape_num);
+    arrays->sources.resize(transition_num);
+    arrays->patterns.resize(transition_num * program.tape_num);
+    program.next_states = arrays->next_states.data();
+    program.writes = arrays->writes.data();
+    program.moves = arrays->moves.data();
+    program.sources = arrays->sources.data();
+    program.patterns = arrays->patterns.data();
+
+    // 按转移编号排列的转移内容，用于计算指纹
+    std::vector<std::string> transition_texts(transition_num);
+
+    for (const auto &pair : tm_map) {
+        const TMTransitionValue &value = pair.second;
+        int t = value.id;
+
+        transition_texts[t] = pair.first.state + '\n' + pair.first.input_chars + '\n' + value.next_state + '\n' +
+                              value.replace_chars + '\n';
+
+        arrays->next_states[t] = state_ids[value.next_state];
+        arrays->sources[t] = state_ids[pair.first.state];
+        std::copy(pair.first.input_chars.begin(), pair.first.input_chars.end(),
+                  arrays->patterns.begin() + t * program.tape_num);
+        for (int i = 0; i < program.tape_num; i++) {
+            char ch = value.replace_chars[i];
+            arrays->writes[t * program.tape_num + i] =
+                ch == '*' ? KEEP : static_cast<uint8_t>(program.encode_map[static_cast<uint8_t>(ch)]);
+
+            int8_t move = 0;
+            switch (value.tape_directions[i]) {
+            case TapeDirection::LEFT:
+                move = -1;
+                break;
+            case TapeDirection::RIGHT:
+                move = 1;
+                break;
+            case TapeDirection::STAY:
+                break;
+            }
+            arrays->moves[t * program.tape_num + i] = move;
+            transition_texts[t] += static_cast<char>('1' + move);
+        }
+    }
+
+    program.hash = FNV_OFFSET;
+    hashString(program.hash, std::to_string(program.tape_num) + ' ' + context.blank_char + ' ' + context.start_state);
+    for (size_t q = 0; q < program.state_names.size(); q++) {
+        hashString(program.hash, program.state_names[q] + (program.final_flags[q] ? "+" : "-"));
+    }
+    hashString(program.hash, std::string(program.symbols.begin(), program.symbols.end()));
+    hashString(program.hash, std::string(context.input_alphabet.begin(), context.input_alphabet.end()));
+    for (const auto &text : transition_texts) {
+        hashString(program.hash, text);
+    }
+
+    // 4. 展开稠密表，若表项过多则保留 TMDeltaMap 作为后备
+    size_t state_num = program.state_names.size();
+    size_t limit = state_num == 0 ? MAX_DENSE_ENTRIES : MAX_DENSE_ENTRIES / state_num;
+    size_t tuple_num = 1;
+    program.dense = true;
+    for (int i = 0; i < program.tape_num; i++) {
+        tuple_num *= program.symbol_num;
+        if (tuple_num > limit) {
+            program.dense = false;
+            break;
+        }
+    }
+
+    if (!program.dense) {
+        program.fallback = context.transitions;
+        return program;
+    }
+
+    program.tuple_num = tuple_num;
+    arrays->table.assign(state_num * tuple_num, -1);
+    arrays->sweeps.assign(state_num * tuple_num, 0);
+    program.table = arrays->table.data();
+    program.sweeps = arrays->sweeps.data();
+
+    // 只展开从初始状态可达的状态，不可达的行保持 -1
+    std::vector<std::vector<int>> successors(state_num);
+    for (const auto &pair : tm_map) {
+        successors[state_ids[pair.first.state]].push_back(state_ids[pair.second.next_state]);
+    }
+    std::vector<char> reachable(state_num, 0);
+    std::vector<int> pending = {program.start_state};
+    reachable[program.start_state] = 1;
+    while (!pending.empty()) {
+        int q = pending.back();
+        pending.pop_back();
+        for (int next : successors[q]) {
+            if (!reachable[next]) {
+                reachable[next] = 1;
+                pending.push_back(next);
+            }
+        }
+    }
+
+    std::string input_chars(program.tape_num, ' ');
+    for (size_t q = 0; q < state_num; q++) {
+        if (!reachable[q] || program.final_flags[q]) {
+            // 到达终止状态即停机，不需要查表
+            continue;
+        }
+        for (size_t tuple = 0; tuple < tuple_num; tuple++) {
+            size_t rest = tuple;
+            for (int i = program.tape_num - 1; i >= 0; i--) {
+                input_chars[i] = program.symbols[rest % program.symbol_num];
+                rest /= program.symbol_num;
+            }
+
+            const TMTransitionValue *value =
+                context.transitions.find(TMTransitionKey(program.state_names[q], input_chars));
+            if (value != nullptr) {
+                arrays->table[q * tuple_num + tuple] = value->id;
+                arrays->sweeps[q * tuple_num + tuple] = program.sweepOf(static_cast<int>(q), value->id, input_chars);
+            }
+        }
+    }
+
+    return program;
+}
+
+int8_t TMProgram::sweepOf(int state, int32_t transition, const std::string &input_chars) const {
+    if (next_states[transition] != state || tape_num > 127) {
+        return 0;
+    }
+
+    const uint8_t *w = getWrites(transition);
+    const int8_t *m = getMoves(transition);
+    int moving = -1;
+    for (int i = 0; i < tape_num; i++) {
+        // 写入的内容必须与读到的相同
+        if (w[i] != KEEP && symbols[w[i]] != input_chars[i]) {
+            return 0;
+        }
+        if (m[i] != 0) {
+            if (moving != -1) {
+                return 0;
+            }
+            moving = i;
+        }
+    }
+
+    if (moving == -1) {
+        return 0;
+    }
+    return static_cast<int8_t>(m[moving] * (moving + 1));
+}
+
+int32_t TMProgram::lookupFallback(int state, const char *syms) const {
+    std::string input_chars(tape_num, ' ');
+    for (int i = 0; i < tape_num; i++) {
+        input_chars[i] = decodeSymbol(syms[i]);
+    }
+
+    const TMTransitionValue *value = fallback.find(TMTransitionKey(state_names[state], input_chars));
+    return value == nullptr ? -1 : value->id;
+}
+
+bool TMProgram::isWildcard(int32_t transition) const {
+    const char *pattern = &patterns[transition * tape_num];
+    return std::find(pattern, pattern + tape_num, '*') != pattern + tape_num;
+}
+
+std::string TMProgram::describeTransition(int32_t transition) const {
+    std::string text = state_names[sources[transition]] + ' ';
+    text.append(&patterns[transition * tape_num], tape_num);
+    text += ' ';
+    const uint8_t *w = getWrites(transition);
+    for (int i = 0; i < tape_num; i++) {
+        text += w[i] == KEEP ? '*' : symbols[w[i]];
+    }
+    text += ' ';
+    const int8_t *m = getMoves(transition);
+    for (int i = 0; i < tape_num; i++) {
+        text += m[i] < 0 ? 'l' : (m[i] > 0 ? 'r' : '*');
+    }
+    return text + ' ' + state_names[next_states[transition]];
+}
+
+std::string TMProgram::encode(const std::string &str) const {
+    std::string ids(str.size(), static_cast<char>(blank));
+    for (size_t i = 0; i < str.size(); i++) {
+        ids[i] = static_cast<char>(encode_map[static_cast<uint8_t>(str[i])]);
+    }
+    return ids;
+}
+
+std::string TMProgram::decode(const std::string &ids) const {
+    std::string str(ids.size(), ' ');
+    for (size_t i = 0; i < ids.size(); i++) {
+        str[i] = decodeSymbol(ids[i]);
+    }
+    return str;
+}
@@ -0,0 +1,278 @@
+/**
+ * Precompiled TM programs (.tmc files).
+ *
+ * 文件是 TMProgram 在内存中的样子，加载时映射整个文件，各数组直接指向文件中的对应部分。
+ * 整数按本机字节序存放，文件头中的字节序标记不符时拒绝加载。
+ *
+ *   偏移  类型      内容
+ *   0     char[8]   魔数 "FLATMPRG"
+ *   8     u32       格式版本 TMProgram::FILE_VERSION
+ *   12    u32       字节序标记 0x01020304
+ *   16    u64       机器指纹 TMProgram::getHash()
+ *   24    i32       纸带数
+ *   28    i32       符号数
+ *   32    i32       初始状态编号
+ *   36    u32       空格符号编号
+ *   40    u32       状态数
+ *   44    u32       转移数
+ *   48    u64       状态名的总长度
+ *   56    u64       源文件内容的长度，没有保存源文件时为 0
+ *   64              以下各部分依次存放，每部分的起点按 8 字节对齐：
+ *                   符号表 char[符号数]，输入字母表标记 char[256]，终止状态标记 char[状态数]，
+ *                   状态名的起点 u32[状态数 + 1] 与状态名，
+ *                   next_states i32[转移数]，writes u8[转移数 * 纸带数]，moves i8[转移数 * 纸带数]，
+ *                   sources i32[转移数]，patterns char[转移数 * 纸带数]，
+ *                   table i32[状态数 * 元组数]，sweeps i8[状态数 * 元组数]，源文件内容 char[源文件长度]
+ *
+ * 各部分的位置完全由文件头决定，文件大小必须与之相符。加载时检查每个转移和表项都在范围内，
+ * 因此损坏的文件不会导致越界访问。
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/program.h"
+#include "utils/mapped_file.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'L', 'A', 'T', 'M', 'P', 'R', 'G'};
+const uint32_t ENDIAN_TAG = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint64_t hash;
+    int32_t tape_num;
+    int32_t symbol_num;
+    int32_t start_state;
+    uint32_t blank;
+    uint32_t state_num;
+    uint32_t transition_num;
+    uint64_t names_size;
+    uint64_t source_size;
+};
+
+static_assert(sizeof(Header) == 64, "unexpected padding in the .tmc header");
+
+/**
+ * Offsets of the sections following the header.
+ */
+struct Layout {
+    uint64_t tuple_num = 1;
+    uint64_t symbols, input_flags, final_flags, name_offsets, names;
+    uint64_t next_states, writes, moves, sources, patterns, table, sweeps, source;
+    uint64_t size;
+
+    // 返回 false 表示文件头中的数量不合理
+    bool compute(const Header &header) {
+        if (header.tape_num < 1 || header.symbol_num < 1 || header.symbol_num > 255 ||
+            header.state_num == 0 || header.start_state < 0 ||
+            static_cast<uint32_t>(header.start_state) >= header.state_num ||
+            header.blank >= static_cast<uint32_t>(header.symbol_num) || header.names_size > (uint64_t(1) << 40) ||
+            header.source_size > (uint64_t(1) << 40)) {
+            return false;
+        }
+        for (int i = 0; i < header.tape_num; i++) {
+            tuple_num *= static_cast<uint64_t>(header.symbol_num);
+            if (tuple_num * header.state_num > TMProgram::MAX_DENSE_ENTRIES) {
+                return false;
+            }
+        }
+        uint64_t entries = tuple_num * header.state_num;
+        uint64_t cells = static_cast<uint64_t>(header.transition_num) * static_cast<uint64_t>(header.tape_num);
+
+        uint64_t pos = sizeof(Header);
+        auto section = [&pos](uint64_t bytes) {
+            uint64_t start = (pos + 7) & ~uint64_t(7);
+            pos = start + bytes;
+            return start;
+        };
+        symbols = section(header.symbol_num);
+        input_flags = section(256);
+        final_flags = section(header.state_num);
+        name_offsets = section((header.state_num + uint64_t(1)) * sizeof(uint32_t));
+        names = section(header.names_size);
+        next_states = section(header.transition_num * sizeof(int32_t));
+        writes = section(cells);
+        moves = section(cells);
+        sources = section(header.transition_num * sizeof(int32_t));
+        patterns = section(cells);
+        table = section(entries * sizeof(int32_t));
+        sweeps = section(entries);
+        source = section(header.source_size);
+        size = pos;
+        return true;
+    }
+};
+
+}
+
+void TMProgram::save(const std::string &path, StringView source_text) const {
+    if (!dense) {
+        throw std::runtime_error("Cannot precompile a machine whose transition table is too large to be dense");
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FILE_VERSION;
+    header.endian_tag = ENDIAN_TAG;
+    header.hash = hash;
+    header.tape_num = tape_num;
+    header.symbol_num = symbol_num;
+    header.start_state = start_state;
+    header.blank = blank;
+    header.state_num = static_cast<uint32_t>(state_names.size());
+    header.transition_num = static_cast<uint32_t>(transition_num);
+    header.names_size = 0;
+    header.source_size = source_text.size();
+    for (const auto &name : state_names) {
+        header.names_size += name.size();
+    }
+
+    Layout layout;
+    if (!layout.compute(header)) {
+        throw std::runtime_error("Cannot precompile this machine");
+    }
+
+    std::string out(layout.size, '\0');
+    auto put = [&out](uint64_t offset, const void *data, size_t bytes) {
+        if (bytes > 0) {
+            std::memcpy(&out[offset], data, bytes);
+        }
+    };
+    put(0, &header, sizeof(header));
+    put(layout.symbols, symbols.data(), symbols.size());
+    put(layout.input_flags, input_flags, sizeof(input_flags));
+    put(layout.final_flags, final_flags.data(), final_flags.size());
+    uint32_t offset = 0;
+    for (size_t q = 0; q <= state_names.size(); q++) {
+        put(layout.name_offsets + q * sizeof(uint32_t), &offset, sizeof(offset));
+        if (q < state_names.size()) {
+            put(layout.names + offset, state_names[q].data(), state_names[q].size());
+            offset += static_cast<uint32_t>(state_names[q].size());
+        }
+    }
+    size_t cells = static_cast<size_t>(transition_num) * tape_num;
+    size_t entries = state_names.size() * tuple_num;
+    put(layout.next_states, next_states, transition_num * sizeof(int32_t));
+    put(layout.writes, writes, cells);
+    put(layout.moves, moves, cells);
+    put(layout.sources, sources, transition_num * sizeof(int32_t));
+    put(layout.patterns, patterns, cells);
+    put(layout.table, table, entries * sizeof(int32_t));
+    put(layout.sweeps, sweeps, entries);
+    put(layout.source, source_text.data(), source_text.size());
+
+    // 临时文件名带上进程号，多个进程同时写同一个缓存项时互不干扰
+    std::string tmp_path = path + ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(out.data(), static_cast<std::streamsize>(out.size())) || !file.flush()) {
+            throw std::runtime_error("Failed to write file: " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+std::shared_ptr<const TMProgram> TMProgram::load(const std::string &path) {
+    auto file = std::make_shared<MappedFile>(path);
+    const char *data = file->data();
+
+    Header header;
+    if (file->size() < sizeof(Header)) {
+        throw std::runtime_error("Not a precompiled TM: " + path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a precompiled TM: " + path);
+    }
+    if (header.version != FILE_VERSION || header.endian_tag != ENDIAN_TAG) {
+        throw std::runtime_error("Unsupported precompiled TM version, compile it again: " + path);
+    }
+    Layout layout;
+    if (!layout.compute(header) || layout.size != file->size()) {
+        throw std::runtime_error("Corrupted precompiled TM: " + path);
+    }
+
+    auto program = std::make_shared<TMProgram>();
+    program->tape_num = header.tape_num;
+    program->symbol_num = header.symbol_num;
+    program->start_state = header.start_state;
+    program->blank = static_cast<uint8_t>(header.blank);
+    program->hash = header.hash;
+    program->transition_num = static_cast<int>(header.transition_num);
+    program->tuple_num = static_cast<size_t>(layout.tuple_num);
+    program->dense = true;
+
+    program->symbols.assign(data + layout.symbols, data + layout.symbols + header.symbol_num);
+    for (int i = 0; i < 256; i++) {
+        program->encode_map[i] = -1;
+    }
+    for (int i = 0; i < header.symbol_num; i++) {
+        program->encode_map[static_cast<uint8_t>(program->symbols[i])] = static_cast<int16_t>(i);
+    }
+    std::memcpy(program->input_flags, data + layout.input_flags, sizeof(program->input_flags));
+    // 输入符号会被直接编码到纸带上，必须属于纸带字母表
+    for (int i = 0; i < 256; i++) {
+        if (program->input_flags[i] && program->encode_map[i] < 0) {
+            throw std::runtime_error("Corrupted precompiled TM: " + path);
+        }
+    }
+    program->final_flags.assign(data + layout.final_flags, data + layout.final_flags + header.state_num);
+
+    const uint32_t *name_offsets = reinterpret_cast<const uint32_t *>(data + layout.name_offsets);
+    program->state_names.reserve(header.state_num);
+    for (uint32_t q = 0; q < header.state_num; q++) {
+        if (name_offsets[q] > name_offsets[q + 1] || name_offsets[q + 1] > header.names_size) {
+            throw std::runtime_error("Corrupted precompiled TM: " + path);
+        }
+        program->state_names.emplace_back(data + layout.names + name_offsets[q], name_offsets[q + 1] - name_offsets[q]);
+    }
+
+    // 运行时直接用这些数组做下标，因此每一项都要在范围内
+    const int32_t *next_states = reinterpret_cast<const int32_t *>(data + layout.next_states);
+    const uint8_t *writes = reinterpret_cast<const uint8_t *>(data + layout.writes);
+    const int8_t *moves = reinterpret_cast<const int8_t *>(data + layout.moves);
+    const int32_t *sources = reinterpret_cast<const int32_t *>(data + layout.sources);
+    const int32_t *table = reinterpret_cast<const int32_t *>(data + layout.table);
+    const int8_t *sweeps = reinterpret_cast<const int8_t *>(data + layout.sweeps);
+    int32_t state_num = static_cast<int32_t>(header.state_num);
+    for (uint32_t t = 0; t < header.transition_num; t++) {
+        if (next_states[t] < 0 || next_states[t] >= state_num || sources[t] < 0 || sources[t] >= state_num) {
+            throw std::runtime_error("Corrupted precompiled TM: " + path);
+        }
+    }
+    uint64_t cells = static_cast<uint64_t>(header.transition_num) * static_cast<uint64_t>(header.tape_num);
+    for (uint64_t i = 0; i < cells; i++) {
+        if ((writes[i] >= header.symbol_num && writes[i] != KEEP) || moves[i] < -1 || moves[i] > 1) {
+            throw std::runtime_error("Corrupted precompiled TM: " + path);
+        }
+    }
+    uint64_t entries = layout.tuple_num * header.state_num;
+    for (uint64_t i = 0; i < entries; i++) {
+        if (table[i] < -1 || table[i] >= static_cast<int64_t>(header.transition_num) ||
+            sweeps[i] < -header.tape_num || sweeps[i] > header.tape_num) {
+            throw std::runtime_error("Corrupted precompiled TM: " + path);
+        }
+    }
+
+    program->next_states = next_states;
+    program->writes = writes;
+    program->moves = moves;
+    program->sources = sources;
+    program->table = table;
+    program->sweeps = sweeps;
+    program->source = StringView(data + layout.source, header.source_size);
+    program->patterns = data + layout.patterns;
+    program->storage = file;
+    return program;
+}
@@ -0,0 +1,148 @@
+/**
+ * Implementation of the TM snapshot format.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/snapshot.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'L', 'A', 'T', 'M', 'S', 'N', 'P'};
+const uint32_t VERSION = 1;
+
+void putInt(std::string &out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+/**
+ * Read fixed-size little-endian fields from a byte buffer.
+ */
+class Reader {
+    const std::string &data;
+    size_t pos = 0;
+
+public:
+
+    explicit Reader(const std::string &data) : data(data) {}
+
+    uint64_t getInt(int bytes) {
+        if (data.size() - pos < static_cast<size_t>(bytes)) {
+            throw std::runtime_error("Truncated snapshot");
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos++])) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string getBytes(uint64_t len) {
+        if (data.size() - pos < len) {
+            throw std::runtime_error("Truncated snapshot");
+        }
+        std::string bytes = data.substr(pos, len);
+        pos += len;
+        return bytes;
+    }
+
+    bool atEnd() const {
+        return pos == data.size();
+    }
+};
+
+}
+
+std::string TMSnapshot::toBytes() const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    putInt(out, VERSION, 4);
+    putInt(out, machine_hash, 8);
+    putInt(out, static_cast<uint32_t>(state), 4);
+    putInt(out, static_cast<uint64_t>(steps), 8);
+    putInt(out, tapes.size(), 4);
+    for (const auto &tape : tapes) {
+        putInt(out, static_cast<uint32_t>(tape.left), 4);
+        putInt(out, static_cast<uint32_t>(tape.head), 4);
+        putInt(out, tape.cells.size(), 8);
+        out += tape.cells;
+    }
+    return out;
+}
+
+void TMSnapshot::save(const std::string &path) const {
+    std::string out = toBytes();
+    std::string tmp_path = path + ".tmp";
+
+    // 改名前把内容写到磁盘上，否则系统崩溃后可能留下改过名的空文件
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to write snapshot: " + tmp_path);
+    }
+    bool ok = true;
+    for (size_t pos = 0; ok && pos < out.size(); ) {
+        ssize_t n = ::write(fd, out.data() + pos, out.size() - pos);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        ok = n > 0;
+        pos += ok ? static_cast<size_t>(n) : 0;
+    }
+    ok = ::fsync(fd) == 0 && ok;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + tmp_path);
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + path);
+    }
+}
+
+TMSnapshot TMSnapshot::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return fromBytes(data, path);
+}
+
+TMSnapshot TMSnapshot::fromBytes(const std::string &data, const std::string &name) {
+    Reader reader(data);
+    if (reader.getBytes(sizeof(MAGIC)) != std::string(MAGIC, sizeof(MAGIC))) {
+        throw std::runtime_error("Not a TM snapshot: " + name);
+    }
+    if (reader.getInt(4) != VERSION) {
+        throw std::runtime_error("Unsupported snapshot version: " + name);
+    }
+
+    TMSnapshot snapshot;
+    snapshot.machine_hash = reader.getInt(8);
+    snapshot.state = static_cast<int32_t>(reader.getInt(4));
+    snapshot.steps = static_cast<long long>(reader.getInt(8));
+    uint32_t tape_num = static_cast<uint32_t>(reader.getInt(4));
+    for (uint32_t i = 0; i < tape_num; i++) {
+        TapeImage tape;
+        tape.left = static_cast<int32_t>(reader.getInt(4));
+        tape.head = static_cast<int32_t>(reader.getInt(4));
+        tape.cells = reader.getBytes(reader.getInt(8));
+        if (tape.head < tape.left || tape.head - static_cast<long long>(tape.left) >= static_cast<long long>(tape.cells.size())) {
+            throw std::runtime_error("Corrupted snapshot: " + name);
+        }
+        snapshot.tapes.push_back(std::move(tape));
+    }
+    if (!reader.atEnd()) {
+        throw std::runtime_error("Corrupted snapshot: " + name);
+    }
+    return snapshot;
+}
@@ -1,129 +1,165 @@
 /**
  * The implementation of Tape for Turing Machines
- * 
+ *
  * Author: Wenze Jin
  */
 
 #include "tm/tape.h"
+#include "tm/scan.h"
+#include "utils/exception.h"
+#include <algorithm>
 
-TMTape::TMTape() : blank('_'), left_idx(0), head(0), tape(1) {
-    tape[0] = blank;
+const int TMTape::MIN_HEADROOM;
+
+TMTape::TMTape() : TMTape('_') {}
+
+TMTape::TMTape(char blank_char) : blank(blank_char) {
+    reset("", 0);
 }
 
-TMTape::TMTape(char blank_char) : blank(blank_char), left_idx(0), head(0), tape(1) {
-    tape[0] = blank;
+TMTape::TMTape(const TMTape &other)
+    : buffer(other.buffer), origin(other.origin), blank(other.blank), memory_limit(other.memory_limit) {
+    cell = buffer.data() + (other.cell - other.buffer.data());
 }
 
-void TMTape::init(std::string init_string) {
-    left_idx = 0;
-    head = 0;
-    tape.clear();
-    for (auto x: init_string) {
-        tape.push_back(x);
-    }
-    if (tape.size() == 0) {
-        tape.push_back(blank);
+TMTape& TMTape::operator=(const TMTape &other) {
+    if (this != &other) {
+        buffer = other.buffer;
+        origin = other.origin;
+        blank = other.blank;
+        memory_limit = other.memory_limit;
+        cell = buffer.data() + (other.cell - other.buffer.data());
     }
+    return *this;
 }
 
-void TMTape::clear() {
-    left_idx = 0;
-    head = 0;
-    tape.clear();
-    tape.push_back(blank);
+void TMTape::reset(const std::string &content, int head_offset) {
+    // content 放在缓冲区中间，两侧各留出余量
+    int headroom = std::max(MIN_HEADROOM, static_cast<int>(content.size() / 2));
+    buffer.assign(content.size() + 2 * headroom, blank);
+    std::copy(content.begin(), content.end(), buffer.begin() + headroom);
+    origin = headroom;
+    cell = buffer.data() + headroom + head_offset;
 }
 
-char TMTape::read() const {
-    return tape[head - left_idx];
+void TMTape::init(std::string init_string) {
+    reset(init_string, 0);
 }
 
-void TMTape::write(char ch) {
-    tape[head - left_idx] = ch;
+void TMTape::restore(const std::string &content, int left, int head) {
+    reset(content, head - left);
+    origin -= left;
 }
 
-void TMTape::moveLeft() {
-    if (head == left_idx) {
-        tape.push_front(blank);
-        left_idx--;
-        head--;
-    } else {
-        head--;
-    }
+void TMTape::clear() {
+    reset("", 0);
 }
 
-void TMTape::moveRight() {
-    if (head - left_idx + 1 == tape.size()) {
-        tape.push_back(blank);
-        head++;
-    } else {
-        head++;
+size_t TMTape::growthFor(size_t size) const {
+    if (memory_limit == 0) {
+        return size;
     }
+    if (size >= memory_limit) {
+        throw ResourceLimitException("Tape memory limit exceeded: " + std::to_string(memory_limit) + " bytes");
+    }
+    return std::min(size, memory_limit - size);
 }
 
-void TMTape::minimize() {
-    while (left_idx < head && tape.size() > 1 && tape.front() == blank) {
-        tape.pop_front();
-        left_idx++;
-    }
-    while (head - left_idx + 1 < tape.size() && tape.size() > 1 && tape.back() == blank) {
-        tape.pop_back();
-    }
+void TMTape::growLeft() {
+    // 在左侧补上与当前大小相同的空白，接近上限时只补到上限
+    size_t grow = growthFor(buffer.size());
+    size_t offset = cell - buffer.data();
+    buffer.insert(buffer.begin(), grow, blank);
+    origin += static_cast<int>(grow);
+    cell = buffer.data() + offset + grow;
 }
 
-std::string TMTape::getAnswer() const {
-    int left = 0;
-    int right = tape.size() - 1;
+void TMTape::growRight() {
+    size_t grow = growthFor(buffer.size());
+    size_t offset = cell - buffer.data();
+    buffer.resize(buffer.size() + grow, blank);
+    cell = buffer.data() + offset;
+}
 
-    for (; left < tape.size(); left++) {
-        if (tape[left] != blank) {
-            break;
-        }
+size_t TMTape::skipRun(int dir, size_t max) {
+    char ch = *cell;
+    size_t len;
+    size_t n;
+
+    // n 为读头旁边连续等于 ch 的格子数；若在范围内遇到不同的格子，读头停在它上面
+    if (dir > 0) {
+        len = std::min<size_t>(buffer.data() + buffer.size() - 1 - cell, max);
+        n = countRunForward(cell + 1, len, ch);
+        n = n < len ? n + 1 : n;
+        cell += n;
+    } else {
+        len = std::min<size_t>(cell - buffer.data(), max);
+        n = countRunBackward(cell - 1, len, ch);
+        n = n < len ? n + 1 : n;
+        cell -= n;
     }
+    return n;
+}
 
-    for (; right >= left && right >= 0; right--) {
-        if (tape[right] != blank) {
-            break;
-        }
+char* TMTape::cellsAt(int pos, int len) {
+    while (pos + origin < 0) {
+        growLeft();
     }
-    
-    std::string temp;
+    while (static_cast<size_t>(pos + origin + len) > buffer.size()) {
+        growRight();
+    }
+    return buffer.data() + origin + pos;
+}
 
+void TMTape::seek(int pos) {
+    cell = cellsAt(pos, 1);
+}
+
+void TMTape::minimize() {
+    int idx = 0;
+    std::string content = getNonBlank(idx);
+    int head = getHead();
+    reset(content, head - idx);
+    origin -= idx;
+}
 
-    for (int i = left; i <= right; i++) {
-        temp += tape[i];
+std::string TMTape::getAnswer() const {
+    auto first = std::find_if(buffer.begin(), buffer.end(), [this](char ch) { return ch != blank; });
+    if (first == buffer.end()) {
+        return std::string();
     }
+    auto last = std::find_if(buffer.rbegin(), buffer.rend(), [this](char ch) { return ch != blank; }).base();
 
-    return temp;
+    return std::string(first, last);
 }
 
 std::string TMTape::getNonBlank(int &idx) const {
-    int left = 0;
-    int right = tape.size() - 1;
-
-    for (; left < tape.size(); left++) {
-        if (tape[left] != blank || left == head - left_idx) {
-            break;
-        }
-    }
+    const char *begin = buffer.data();
+    const char *end = begin + buffer.size();
 
-    for (; right > head - left_idx && right >= 0; right--) {
-        if (tape[right] != blank || right == head - left_idx) {
-            break;
-        }
+    // 最左的非空白格子，但不越过读头
+    const char *left = begin;
+    while (left < cell && *left == blank) {
+        left++;
     }
-    
-    std::string temp;
 
-    if (left > right) {
-        idx = head;
-        return temp + blank;
+    // 最右的非空白格子，但不越过读头
+    const char *right = end - 1;
+    while (right > cell && *right == blank) {
+        right--;
     }
 
-    for (int i = left; i <= right; i++) {
-        temp += tape[i];
-    }
+    idx = static_cast<int>(left - begin) - origin;
 
-    idx = left + left_idx;
+    return std::string(left, right + 1);
+}
 
-    return temp;
-}
\ No newline at end of file
+std::string TMTape::getCells(int pos, int len) const {
+    std::string content(len, blank);
+    int begin = std::max(pos, -origin);
+    int end = std::min(pos + len, static_cast<int>(buffer.size()) - origin);
+    for (int i = begin; i < end; i++) {
+        content[i - pos] = buffer[i + origin];
+    }
+    return content;
+}
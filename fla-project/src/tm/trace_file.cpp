@@ -0,0 +1,315 @@
+/**
+ * Implementation of TM trace recording and replay.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/trace_file.h"
+#include "utils/hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const char MAGIC[8] = {'F', 'L', 'A', 'T', 'M', 'T', 'R', 'C'};
+const char KEYS_MAGIC[8] = {'F', 'L', 'A', 'T', 'M', 'K', 'E', 'Y'};
+const uint32_t VERSION = 1;
+const size_t CHUNK_SIZE = 1 << 16;
+const uint64_t MAX_IMAGE_SIZE = uint64_t(1) << 40;
+
+void putInt(std::string &out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+uint64_t getInt(const char *data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t fileSize(std::ifstream &file) {
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+    return size;
+}
+
+// 检查格局能否在 program 上回放
+void checkSnapshot(const TMSnapshot &snapshot, const TMProgram &program) {
+    if (snapshot.machine_hash != program.getHash()) {
+        throw std::runtime_error("Trace was recorded on a different machine");
+    }
+    if (snapshot.tapes.size() != static_cast<size_t>(program.getTapeNum()) || snapshot.state < 0 ||
+        snapshot.state >= program.getStateNum()) {
+        throw std::runtime_error("Trace does not match the machine");
+    }
+    for (const auto &image : snapshot.tapes) {
+        for (char id : image.cells) {
+            if (static_cast<uint8_t>(id) >= program.getSymbolNum()) {
+                throw std::runtime_error("Trace does not match the machine");
+            }
+        }
+    }
+}
+
+}
+
+std::string TMTraceRecorder::keyframePath(const std::string &path) {
+    return path + ".keys";
+}
+
+TMTraceRecorder::TMTraceRecorder(const std::string &path, const TMSnapshot &start, bool keyframes)
+    : path(path), file(path, std::ios::binary | std::ios::trunc) {
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+    std::string image = start.toBytes();
+    buffer.assign(MAGIC, sizeof(MAGIC));
+    putInt(buffer, VERSION, 4);
+    putInt(buffer, image.size(), 8);
+    buffer += image;
+    buffer.reserve(FLUSH_SIZE + 8);
+
+    std::string keys_path = keyframePath(path);
+    if (!keyframes) {
+        std::remove(keys_path.c_str());
+        return;
+    }
+    keys.open(keys_path, std::ios::binary | std::ios::trunc);
+    std::string header(KEYS_MAGIC, sizeof(KEYS_MAGIC));
+    putInt(header, VERSION, 4);
+    putInt(header, fnv1a(image), 8);
+    if (!keys.write(header.data(), static_cast<std::streamsize>(header.size()))) {
+        throw std::runtime_error("Failed to write file: " + keys_path);
+    }
+}
+
+TMTraceRecorder::~TMTraceRecorder() {
+    try {
+        close();
+    } catch (const std::runtime_error &) {
+    }
+}
+
+void TMTraceRecorder::writeBuffer() {
+    if (!file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+    written += buffer.size();
+    buffer.clear();
+}
+
+void TMTraceRecorder::keyframe(const TMSnapshot &snapshot) {
+    std::string image = snapshot.toBytes();
+    std::string entry;
+    putInt(entry, static_cast<uint64_t>(snapshot.steps), 8);
+    putInt(entry, written + buffer.size(), 8);
+    putInt(entry, image.size(), 8);
+    entry += image;
+    if (!keys.write(entry.data(), static_cast<std::streamsize>(entry.size()))) {
+        throw std::runtime_error("Failed to write file: " + keyframePath(path));
+    }
+}
+
+void TMTraceRecorder::close() {
+    writeBuffer();
+    if (!file.flush()) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+    if (keys.is_open() && !keys.flush()) {
+        throw std::runtime_error("Failed to write file: " + keyframePath(path));
+    }
+}
+
+TMTraceReplay::TMTraceReplay(const std::string &path, std::shared_ptr<const TMProgram> program)
+    : program(std::move(program)), path(path), file(path, std::ios::binary), chunk(CHUNK_SIZE),
+      syms(this->program->getTapeNum()) {
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    uint64_t trace_size = fileSize(file);
+
+    char header[sizeof(MAGIC) + 12];
+    if (!file.read(header, sizeof(header)) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a TM trace: " + path);
+    }
+    if (getInt(header + sizeof(MAGIC), 4) != VERSION) {
+        throw std::runtime_error("Unsupported trace version: " + path);
+    }
+    uint64_t image_size = getInt(header + sizeof(MAGIC) + 4, 8);
+    if (image_size > trace_size - sizeof(header)) {
+        throw std::runtime_error("Corrupted trace: " + path);
+    }
+    std::string image(static_cast<size_t>(image_size), '\0');
+    if (!file.read(&image[0], static_cast<std::streamsize>(image.size()))) {
+        throw std::runtime_error("Corrupted trace: " + path);
+    }
+    start = TMSnapshot::fromBytes(image, path);
+    checkSnapshot(start, *this->program);
+
+    keyframes.push_back({start.steps, sizeof(header) + image_size, 0, 0});
+    loadKeyframes(fnv1a(image), trace_size);
+    restore(keyframes.front());
+}
+
+void TMTraceReplay::loadKeyframes(uint64_t trace_id, uint64_t trace_size) {
+    keys.open(TMTraceRecorder::keyframePath(path), std::ios::binary);
+    if (!keys.is_open()) {
+        return;
+    }
+    uint64_t keys_size = fileSize(keys);
+
+    // 属于其他运行的关键帧文件直接忽略
+    char header[sizeof(KEYS_MAGIC) + 12];
+    if (!keys.read(header, sizeof(header)) || std::memcmp(header, KEYS_MAGIC, sizeof(KEYS_MAGIC)) != 0 ||
+        getInt(header + sizeof(KEYS_MAGIC), 4) != VERSION || getInt(header + sizeof(KEYS_MAGIC) + 4, 8) != trace_id) {
+        keys.close();
+        return;
+    }
+
+    // 运行被中途杀死时，最后的关键帧可能不完整，或者指向轨迹文件中没有写出的部分
+    uint64_t pos = sizeof(header);
+    char entry[24];
+    while (keys.read(entry, sizeof(entry))) {
+        Keyframe keyframe;
+        keyframe.step = static_cast<long long>(getInt(entry, 8));
+        keyframe.offset = getInt(entry + 8, 8);
+        keyframe.image_offset = pos + sizeof(entry);
+        keyframe.image_size = getInt(entry + 16, 8);
+        if (keyframe.image_size > keys_size - keyframe.image_offset || keyframe.offset > trace_size ||
+            keyframe.offset < keyframes.back().offset || keyframe.step <= keyframes.back().step) {
+            break;
+        }
+        keyframes.push_back(keyframe);
+        pos = keyframe.image_offset + keyframe.image_size;
+        keys.seekg(static_cast<std::streamoff>(pos));
+    }
+    keys.clear();
+}
+
+void TMTraceReplay::restore(const Keyframe &keyframe) {
+    TMSnapshot loaded;
+    if (keyframe.image_size != 0) {
+        std::string image(static_cast<size_t>(keyframe.image_size), '\0');
+        keys.clear();
+        keys.seekg(static_cast<std::streamoff>(keyframe.image_offset));
+        if (!keys.read(&image[0], static_cast<std::streamsize>(image.size()))) {
+            throw std::runtime_error("Corrupted trace: " + TMTraceRecorder::keyframePath(path));
+        }
+        loaded = TMSnapshot::fromBytes(image, TMTraceRecorder::keyframePath(path));
+        checkSnapshot(loaded, *program);
+        if (loaded.steps != keyframe.step) {
+            throw std::runtime_error("Corrupted trace: " + TMTraceRecorder::keyframePath(path));
+        }
+    }
+    const TMSnapshot &snapshot = keyframe.image_size != 0 ? loaded : start;
+
+    state = snapshot.state;
+    step_cnt = snapshot.steps;
+    tapes.clear();
+    for (const auto &image : snapshot.tapes) {
+        tapes.emplace_back(program->getBlank());
+        tapes.back().restore(image.cells, image.left, image.head);
+    }
+
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(keyframe.offset));
+    chunk_pos = 0;
+    chunk_len = 0;
+}
+
+bool TMTraceReplay::readByte(uint8_t &byte) {
+    if (chunk_pos == chunk_len) {
+        file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        chunk_len = static_cast<size_t>(file.gcount());
+        chunk_pos = 0;
+        if (chunk_len == 0) {
+            return false;
+        }
+    }
+    byte = static_cast<uint8_t>(chunk[chunk_pos++]);
+    return true;
+}
+
+bool TMTraceReplay::step() {
+    uint32_t transition = 0;
+    uint8_t byte;
+    int shift = 0;
+    do {
+        // 最后一条记录不完整时（写到一半被杀死）当作轨迹在此结束
+        if (shift > 28 || !readByte(byte)) {
+            return false;
+        }
+        transition |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    const TMProgram &prog = *program;
+    if (transition >= static_cast<uint32_t>(prog.getTransitionNum())) {
+        throw std::runtime_error("Corrupted trace: " + path);
+    }
+    // 记录的转移必须是机器在当前格局下会选的转移，否则轨迹来自别的机器或输入
+    for (size_t i = 0; i < tapes.size(); i++) {
+        syms[i] = tapes[i].read();
+    }
+    if (prog.lookup(state, syms.data()) != static_cast<int32_t>(transition)) {
+        throw std::runtime_error("Trace does not match the machine at step " + std::to_string(step_cnt) + ": " + path);
+    }
+    const uint8_t *writes = prog.getWrites(static_cast<int32_t>(transition));
+    const int8_t *moves = prog.getMoves(static_cast<int32_t>(transition));
+    for (size_t i = 0; i < tapes.size(); i++) {
+        if (writes[i] != TMProgram::KEEP) {
+            tapes[i].write(static_cast<char>(writes[i]));
+        }
+        if (moves[i] < 0) {
+            tapes[i].moveLeft();
+        } else if (moves[i] > 0) {
+            tapes[i].moveRight();
+        }
+    }
+    state = prog.getNextState(static_cast<int32_t>(transition));
+    step_cnt++;
+    return true;
+}
+
+bool TMTraceReplay::seek(long long target) {
+    target = std::max(target, keyframes.front().step);
+
+    // 最后一个不晚于 target 的关键帧
+    auto it = std::upper_bound(keyframes.begin(), keyframes.end(), target,
+                               [](long long step, const Keyframe &keyframe) { return step < keyframe.step; });
+    --it;
+    if (target < step_cnt || it->step > step_cnt) {
+        restore(*it);
+    }
+    while (step_cnt < target) {
+        if (!step()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TMTraceReplay::back(long long n) {
+    seek(step_cnt - n);
+}
+
+void TMTraceReplay::render(TMTraceWriter &writer) {
+    writer.beginConfiguration(step_cnt, program->getStateName(state));
+    for (size_t i = 0; i < tapes.size(); i++) {
+        int left = 0;
+        std::string ids = tapes[i].getNonBlank(left);
+        cells.resize(ids.size());
+        for (size_t j = 0; j < ids.size(); j++) {
+            cells[j] = program->decodeSymbol(ids[j]);
+        }
+        writer.tape(static_cast<int>(i), cells.data(), cells.size(), left, tapes[i].getHead());
+    }
+    writer.endConfiguration();
+}
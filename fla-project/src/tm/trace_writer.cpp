@@ -0,0 +1,96 @@
+/**
+ * Implementation of the verbose trace writer.
+ *
+ * Author: Wenze Jin
+ */
+
+#include "tm/trace_writer.h"
+
+namespace {
+
+// 追加十进制整数，不经过 std::to_string
+void appendInt(std::string &out, long long value) {
+    char digits[24];
+    int n = 0;
+    unsigned long long v = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : value;
+    do {
+        digits[n++] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    if (value < 0) {
+        out += '-';
+    }
+    while (n > 0) {
+        out += digits[--n];
+    }
+}
+
+// 行首的 "Index0 : "，名字不足 7 个字符时用空格补齐
+void appendHeading(std::string &out, const char *name, int i) {
+    size_t start = out.size();
+    out += name;
+    appendInt(out, i);
+    while (out.size() - start < 7) {
+        out += ' ';
+    }
+    out += ": ";
+}
+
+}
+
+void TMTraceWriter::line(const std::string &message) {
+    buffer += message;
+    buffer += '\n';
+    flushIfFull();
+}
+
+void TMTraceWriter::beginConfiguration(long long step, const std::string &state) {
+    buffer += "Step   : ";
+    appendInt(buffer, step);
+    buffer += "\nState  : ";
+    buffer += state;
+    buffer += '\n';
+}
+
+void TMTraceWriter::tape(int i, const char *cells, size_t len, int left, int head) {
+    index_line.clear();
+    tape_line.clear();
+    head_line.clear();
+    appendHeading(index_line, "Index", i);
+    appendHeading(tape_line, "Tape", i);
+    appendHeading(head_line, "Head", i);
+
+    for (size_t j = 0; j < len; j++) {
+        int idx = left + static_cast<int>(j);
+        // 每格的宽度为下标的位数加一
+        size_t before = index_line.size();
+        appendInt(index_line, idx < 0 ? -static_cast<long long>(idx) : idx);
+        index_line += ' ';
+        size_t width = index_line.size() - before;
+
+        tape_line += cells[j];
+        tape_line.append(width - 1, ' ');
+        head_line += idx == head ? '^' : ' ';
+        head_line.append(width - 1, ' ');
+    }
+
+    buffer += index_line;
+    buffer += '\n';
+    buffer += tape_line;
+    buffer += '\n';
+    buffer += head_line;
+    buffer += '\n';
+}
+
+void TMTraceWriter::endConfiguration() {
+    buffer += "---------------------------------------------\n";
+    flushIfFull();
+}
+
+void TMTraceWriter::flush() {
+    if (!buffer.empty()) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    out.flush();
+}
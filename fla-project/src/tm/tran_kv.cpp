@@ -6,9 +6,11 @@
 
 #include "tm/tran_kv.h"
 
+#include <algorithm>
 #include <iostream>
+#include <utility>
 
-TMTransitionKey::TMTransitionKey(std::string state, std::string input_chars) : state(state), input_chars(input_chars) {}
+TMTransitionKey::TMTransitionKey(std::string state, std::string input_chars) : state(std::move(state)), input_chars(std::move(input_chars)) {}
 
 bool TMTransitionKey::operator==(const TMTransitionKey& other) const {
     return state == other.state && input_chars == other.input_chars;
@@ -26,7 +28,7 @@ std::size_t TMTransitionKeyHash::operator()(const TMTransitionKey& key) const {
 
 
 TMTransitionValue::TMTransitionValue(std::string next_state, std::string replace_chars, const std::vector<TapeDirection>& tape_directions) 
-    : next_state(next_state), replace_chars(replace_chars), tape_directions(tape_directions){}
+    : next_state(std::move(next_state)), replace_chars(std::move(replace_chars)), tape_directions(tape_directions), id(-1) {}
 
 
 
@@ -36,44 +38,179 @@ TMQueryResult::TMQueryResult(std::string next_state, std::string replace_chars,
 TMQueryResult::TMQueryResult() : success(false) {}
 
 
-void TMDeltaMap::insert(const TMTransitionKey &key, const TMTransitionValue &value) {
-    _map.emplace(key, value);
+void TMWildcardIndex::insert(const std::string &pattern) {
+    if (patterns.empty()) {
+        star_masks.resize(pattern.size());
+        char_masks.resize(pattern.size());
+    } else if (pattern.size() != star_masks.size()) {
+        // 长度与纸带数不符的模式永远不会匹配，TMContext::validate 会拒绝它
+        return;
+    }
+
+    size_t bit = patterns.size();
+    patterns.push_back(pattern);
+
+    if (bit % 64 == 0) {
+        // 所有位图增加一个字
+        for (auto &mask : star_masks) {
+            mask.push_back(0);
+        }
+        for (auto &masks : char_masks) {
+            for (auto &pair : masks) {
+                pair.second.push_back(0);
+            }
+        }
+    }
+
+    size_t words = bit / 64 + 1;
+    uint64_t flag = uint64_t(1) << (bit % 64);
+
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] == '*') {
+            star_masks[i][bit / 64] |= flag;
+        } else {
+            auto &mask = char_masks[i][pattern[i]];
+            mask.resize(words, 0);
+            mask[bit / 64] |= flag;
+        }
+    }
 }
 
-// Helper function to check if input_chars matches stored_chars with wildcard logic
-bool matchesWithWildcard(const std::string& input_chars, const std::string& stored_chars) {
-    if (input_chars.size() != stored_chars.size()) return false;
+const std::string* TMWildcardIndex::match(const std::string &input_chars) const {
+    if (input_chars.size() != star_masks.size()) {
+        return nullptr;
+    }
+
+    size_t words = star_masks.empty() ? 0 : star_masks[0].size();
+    std::vector<uint64_t> acc(words, ~uint64_t(0));
+
+    for (size_t i = 0; i < input_chars.size(); i++) {
+        const std::vector<uint64_t> &stars = star_masks[i];
+        auto it = char_masks[i].find(input_chars[i]);
+        const std::vector<uint64_t> *chars = it == char_masks[i].end() ? nullptr : &it->second;
 
-    for (size_t i = 0; i < input_chars.size(); ++i) {
-        if (stored_chars[i] != '*' && stored_chars[i] != input_chars[i]) {
-            return false;
+        bool any = false;
+        for (size_t w = 0; w < words; w++) {
+            acc[w] &= stars[w] | (chars != nullptr ? (*chars)[w] : 0);
+            any = any || acc[w] != 0;
+        }
+        if (!any) {
+            return nullptr;
+        }
+    }
+
+    for (size_t w = 0; w < words; w++) {
+        if (acc[w] != 0) {
+            return &patterns[w * 64 + __builtin_ctzll(acc[w])];
         }
     }
-    return true;
+    return nullptr;
 }
 
 
-TMQueryResult TMDeltaMap::query(const TMTransitionKey &key) const {
-    TMTransitionValue result("", "", std::vector<TapeDirection>());
-    bool success = false;
-    auto it = _map.find(key);
-    if (it != _map.end()) {
-        result = it->second;
-        success = true;
-    } else {
-        for (const auto& pair : _map) {
-            const TMTransitionKey& stored_key = pair.first;
-            if (stored_key.state == key.state && matchesWithWildcard(key.input_chars, stored_key.input_chars)) {
-                result = pair.second;
-                success = true;
-                break;
+void TMDeltaMap::insert(TMTransitionKey key, TMTransitionValue value) {
+    auto it = _map.emplace(std::move(key), std::move(value));
+    if (it.second) {
+        const TMTransitionKey &stored = it.first->first;
+        it.first->second.id = static_cast<int>(_map.size()) - 1;
+        size_t stars = std::count(stored.input_chars.begin(), stored.input_chars.end(), '*');
+        if (stars > 0) {
+            auto &groups = _wildcards[stored.state];
+            if (groups.size() <= stars) {
+                groups.resize(stars + 1);
             }
+            groups[stars].insert(stored.input_chars);
         }
     }
+}
 
-    if (success) {
-        return TMQueryResult(result.next_state, result.replace_chars, result.tape_directions);
+
+TMQueryResult TMDeltaMap::query(const TMTransitionKey &key) const {
+    const TMTransitionValue *result = find(key);
+
+    if (result != nullptr) {
+        return TMQueryResult(result->next_state, result->replace_chars, result->tape_directions);
     } else {
         return TMQueryResult();
     }
-}
\ No newline at end of file
+}
+
+const TMTransitionValue* TMDeltaMap::find(const TMTransitionKey &key) const {
+    auto it = _map.find(key);
+    if (it != _map.end()) {
+        return &it->second;
+    }
+
+    // 精确匹配失败，按通配符个数从少到多查询该状态的通配符索引
+    auto groups = _wildcards.find(key.state);
+    if (groups == _wildcards.end()) {
+        return nullptr;
+    }
+
+    for (const auto &index : groups->second) {
+        const std::string *pattern = index.match(key.input_chars);
+        if (pattern != nullptr) {
+            return &_map.find(TMTransitionKey(key.state, *pattern))->second;
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<std::string> TMDeltaMap::findAmbiguousOverlaps() const {
+    std::vector<std::string> reports;
+
+    // 按声明顺序收集每个状态下带通配符的转移
+    std::vector<const TMTransitionKey*> keys(_map.size(), nullptr);
+    for (const auto &pair : _map) {
+        keys[pair.second.id] = &pair.first;
+    }
+
+    for (size_t a = 0; a < keys.size(); a++) {
+        const TMTransitionKey &first = *keys[a];
+        size_t stars = std::count(first.input_chars.begin(), first.input_chars.end(), '*');
+        if (stars == 0) {
+            continue;
+        }
+
+        for (size_t b = a + 1; b < keys.size(); b++) {
+            const TMTransitionKey &second = *keys[b];
+            if (second.state != first.state || second.input_chars.size() != first.input_chars.size() ||
+                static_cast<size_t>(std::count(second.input_chars.begin(), second.input_chars.end(), '*')) != stars) {
+                continue;
+            }
+
+            // 两个模式的交集，若某一位冲突则不重叠
+            std::string overlap = first.input_chars;
+            bool disjoint = false;
+            for (size_t i = 0; i < overlap.size(); i++) {
+                if (overlap[i] == '*') {
+                    overlap[i] = second.input_chars[i];
+                } else if (second.input_chars[i] != '*' && second.input_chars[i] != overlap[i]) {
+                    disjoint = true;
+                    break;
+                }
+            }
+            if (disjoint) {
+                continue;
+            }
+
+            // 交集被一个精确的转移完全覆盖，或两者的动作相同，则没有歧义
+            if (_map.count(TMTransitionKey(first.state, overlap)) > 0) {
+                continue;
+            }
+            const TMTransitionValue &v1 = _map.find(first)->second;
+            const TMTransitionValue &v2 = _map.find(second)->second;
+            if (v1.next_state == v2.next_state && v1.replace_chars == v2.replace_chars &&
+                v1.tape_directions == v2.tape_directions) {
+                continue;
+            }
+
+            reports.push_back("state " + first.state + ": '" + first.input_chars + "' and '" +
+                              second.input_chars + "' both match '" + overlap + "', '" +
+                              first.input_chars + "' is used since it is declared first");
+        }
+    }
+
+    return reports;
+}
@@ -0,0 +1,138 @@
+/**
+ * Implementation of the batch runner.
+ */
+
+#include "utils/batch_runner.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Chunk {
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::exception_ptr error;
+    bool done = false;
+};
+
+}
+
+BatchRunner::BatchRunner(int threads) : threads(threads < 1 ? 1 : threads) {}
+
+void BatchRunner::run(std::istream &in, std::ostream &out, const JobFactory &factory) {
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable chunk_done;
+
+    // 等待处理的块，以及按输入顺序排列的所有未写出的块
+    std::deque<std::shared_ptr<Chunk>> pending;
+    std::deque<std::shared_ptr<Chunk>> in_flight;
+    bool finished = false;
+
+    auto worker = [&]() {
+        Job job = factory();
+        while (true) {
+            std::shared_ptr<Chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [&]() { return finished || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                chunk = pending.front();
+                pending.pop_front();
+            }
+
+            chunk->outputs.reserve(chunk->inputs.size());
+            try {
+                for (const auto &input : chunk->inputs) {
+                    chunk->outputs.push_back(job(input));
+                }
+            } catch (...) {
+                chunk->error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunk->done = true;
+            }
+            chunk_done.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+
+    // 写出最早的块，必要时等待它处理完
+    auto writeFront = [&]() {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunk_done.wait(lock, [&]() { return in_flight.front()->done; });
+            chunk = in_flight.front();
+            in_flight.pop_front();
+        }
+        for (size_t i = 0; i < chunk->outputs.size(); i++) {
+            out << chunk->outputs[i] << '\n';
+        }
+        if (chunk->error) {
+            std::rethrow_exception(chunk->error);
+        }
+    };
+
+    auto stopWorkers = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+            pending.clear();
+        }
+        work_ready.notify_all();
+        for (auto &thread : workers) {
+            thread.join();
+        }
+    };
+
+    try {
+        std::string line;
+        bool more = true;
+        while (more) {
+            auto chunk = std::make_shared<Chunk>();
+            while (chunk->inputs.size() < CHUNK && (more = static_cast<bool>(std::getline(in, line)))) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                chunk->inputs.push_back(line);
+            }
+            if (chunk->inputs.empty()) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(chunk);
+                in_flight.push_back(chunk);
+            }
+            work_ready.notify_one();
+
+            if (in_flight.size() >= static_cast<size_t>(threads) * 2) {
+                writeFront();
+            }
+        }
+        while (!in_flight.empty()) {
+            writeFront();
+        }
+    } catch (...) {
+        stopWorkers();
+        throw;
+    }
+
+    stopWorkers();
+    out.flush();
+}
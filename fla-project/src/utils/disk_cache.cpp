@@ -0,0 +1,106 @@
+/**
+ * Implementation of the disk cache.
+ */
+
+#include "utils/disk_cache.h"
+#include "utils/hash.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// 逐级创建目录，目录已存在也算成功
+bool makeDirectories(const std::string &dir) {
+    for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+        std::string prefix = dir.substr(0, pos);
+        if (::mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (pos == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+}
+
+DiskCache::DiskCache(std::string dir, uint64_t max_bytes) : dir(std::move(dir)), max_bytes(max_bytes) {}
+
+std::string DiskCache::defaultDirectory() {
+    const char *xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg != nullptr && xdg[0] != '\0') {
+        return std::string(xdg) + "/fla";
+    }
+    const char *home = std::getenv("HOME");
+    if (home != nullptr && home[0] != '\0') {
+        return std::string(home) + "/.cache/fla";
+    }
+    return "";
+}
+
+std::string DiskCache::entryPath(StringView content, uint32_t version, const std::string &extension) const {
+    if (dir.empty() || !makeDirectories(dir)) {
+        return "";
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    fnv1a(hash, content.data(), content.size());
+    fnv1a(hash, reinterpret_cast<const char *>(&version), sizeof(version));
+    fnv1a(hash, extension.data(), extension.size());
+
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    return dir + "/" + name + "." + extension;
+}
+
+void DiskCache::touch(const std::string &entry) const {
+    // 失败时只影响淘汰的顺序
+    ::utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+}
+
+void DiskCache::evict(const std::string &keep) const {
+    DIR *handle = ::opendir(dir.c_str());
+    if (handle == nullptr) {
+        return;
+    }
+
+    // (修改时间, 大小, 路径)，包括中断的写入留下的临时文件
+    struct File {
+        struct timespec mtime;
+        uint64_t size;
+        std::string path;
+    };
+    std::vector<File> files;
+    uint64_t total = 0;
+    while (const struct dirent *item = ::readdir(handle)) {
+        std::string path = dir + "/" + item->d_name;
+        struct stat info;
+        if (::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        total += static_cast<uint64_t>(info.st_size);
+        if (path != keep) {
+            files.push_back(File{info.st_mtim, static_cast<uint64_t>(info.st_size), path});
+        }
+    }
+    ::closedir(handle);
+
+    std::sort(files.begin(), files.end(), [](const File &a, const File &b) {
+        return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec : a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+    for (const File &file : files) {
+        if (total <= max_bytes) {
+            break;
+        }
+        if (std::remove(file.path.c_str()) == 0) {
+            total -= file.size;
+        }
+    }
+}
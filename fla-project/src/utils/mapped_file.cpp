@@ -0,0 +1,42 @@
+/**
+ * Implementation of the read-only file mapping.
+ */
+
+#include "utils/mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length > 0) {
+        void *addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Failed to map file " + path + ": " + error);
+        }
+        bytes = static_cast<const char *>(addr);
+    }
+    // 映射建立后不再需要文件描述符
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        ::munmap(const_cast<char *>(bytes), length);
+    }
+}
@@ -1,56 +1,125 @@
-
 #include "utils/parse_token.h"
 #include "utils/exception.h"
 
-std::set<std::string> parseStrSet(const std::string &input) {
-    std::set<std::string> result;
+namespace {
 
-    // 找到第一个 '{' 和第一个 '}'
-    size_t start = input.find('{');
-    size_t end = input.find('}');
+struct CharClassTable {
+    uint8_t classes[256];
 
-    // 如果找到有效的大括号位置
-    if (start != std::string::npos && end != std::string::npos && start == 0 && end == input.length() - 1) {
-        std::string content = input.substr(start + 1, end - start - 1);  // 提取 {} 中的内容
+    CharClassTable() {
+        for (int c = 0; c < 256; c++) {
+            uint8_t cls = 0;
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r') {
+                cls |= CHAR_SPACE;
+            }
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_') {
+                cls |= CHAR_STATE;
+            }
+            if (c > ' ' && c <= '~' && c != ',' && c != ';' && c != '{' && c != '}' && c != '*' && c != '_') {
+                cls |= CHAR_SYMBOL;
+            }
+            classes[c] = cls;
+        }
+    }
+};
 
-        // 使用 stringstream 按逗号分割字符串，但不去除空格
-        std::stringstream ss(content);
-        std::string token;
-        while (std::getline(ss, token, ',')) {
-            result.insert(token);  
+const CharClassTable TABLE;
+
+/**
+ * Call f on each comma separated element of a "{...}" set.
+ * 与按 ',' 逐个 std::getline 相同：不去除空格，最后一个 ',' 之后为空时不产生空元素。
+ */
+template <typename F>
+void splitSet(StringView input, F f) {
+    // 第一个 '{' 在开头，第一个 '}' 在末尾
+    if (input.empty() || input.find('{') != 0 || input.find('}') != input.size() - 1) {
+        throw AutomataSyntaxException(input.str(), "Expected {}.");
+    }
+    StringView content = input.substr(1, input.size() - 2);
+
+    size_t start = 0;
+    while (start < content.size()) {
+        size_t comma = content.find(',', start);
+        if (comma == StringView::npos) {
+            f(content.substr(start));
+            break;
         }
-    } else {
-        throw AutomataSyntaxException(input, "Expected {}.");
+        f(content.substr(start, comma - start));
+        start = comma + 1;
     }
+}
 
-    return result;
 }
 
+const uint8_t *const CHAR_CLASSES = TABLE.classes;
+
+bool isStateName(StringView token) {
+    if (token.empty()) {
+        return false;
+    }
+    for (char c : token) {
+        if (!hasCharClass(c, CHAR_STATE)) {
+            return false;
+        }
+    }
+    return true;
+}
 
+std::set<std::string> parseStrSet(StringView input) {
+    std::set<std::string> result;
+    splitSet(input, [&result](StringView token) { result.insert(token.str()); });
+    return result;
+}
 
-std::set<char> parseCharSet(const std::string &input) {
+std::set<char> parseCharSet(StringView input) {
     std::set<char> result;
+    splitSet(input, [&result](StringView token) {
+        if (token.size() != 1) {
+            throw AutomataSyntaxException(token.str(), "only single character allowed");
+        }
+        result.insert(token[0]);
+    });
+    return result;
+}
 
-    // 找到第一个 '{' 和最后一个 '}'
-    size_t start = input.find('{');
-    size_t end = input.find('}');
+bool LineTokenizer::next() {
+    if (pos >= text.size()) {
+        return false;
+    }
 
-    // 如果找到有效的大括号位置
-    if (start != std::string::npos && end != std::string::npos && start == 0 && end == input.length() - 1) {
-        std::string content = input.substr(start + 1, end - start - 1);  // 提取 {} 中的内容
+    size_t end = text.find('\n', pos);
+    if (end == StringView::npos) {
+        end = text.size();
+    }
+    StringView line = text.substr(pos, end - pos);
+    pos = end + 1;
+    line_idx++;
 
-        // 使用 stringstream 按逗号分割字符串，但不去除空格
-        std::stringstream ss(content);
-        std::string token;
-        while (std::getline(ss, token, ',')) {
-            if (token.size() != 1) {
-                throw AutomataSyntaxException(token, "only single character allowed");
-            }
-            result.insert(token[0]);  
-        }
-    } else {
-        throw AutomataSyntaxException(input, "Expected {}.");
+    // 去掉注释和行尾的空格、制表符
+    size_t comment = line.find(';');
+    size_t len = comment == StringView::npos ? line.size() : comment;
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        len--;
     }
+    current = line.substr(0, len);
 
-    return result;
-}
\ No newline at end of file
+    token_num = 0;
+    size_t i = 0;
+    while (true) {
+        while (i < len && hasCharClass(current[i], CHAR_SPACE)) {
+            i++;
+        }
+        if (i == len) {
+            break;
+        }
+        size_t start = i;
+        while (i < len && !hasCharClass(current[i], CHAR_SPACE)) {
+            i++;
+        }
+        if (token_num < MAX_TOKENS) {
+            tokens[token_num] = current.substr(start, i - start);
+        }
+        token_num++;
+    }
+    return true;
+}
@@ -0,0 +1,162 @@
+/**
+ * Implementation of the run profile reports.
+ */
+
+#include "utils/run_profile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iomanip>
+
+namespace {
+
+// 按计数从大到小排列的下标，计数相同时按下标
+std::vector<size_t> byCount(const std::vector<long long> &counts) {
+    std::vector<size_t> order(counts.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&counts](size_t a, size_t b) { return counts[a] > counts[b]; });
+    return order;
+}
+
+double fraction(long long part, long long whole) {
+    return whole == 0 ? 0.0 : static_cast<double>(part) / static_cast<double>(whole);
+}
+
+std::string jsonString(const std::string &str) {
+    std::string out = "\"";
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+            out += ch;
+        } else if (static_cast<unsigned char>(ch) < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned char>(ch));
+            out += escape;
+        } else {
+            out += ch;
+        }
+    }
+    return out + "\"";
+}
+
+}
+
+void RunProfile::reset(size_t transition_num) {
+    transition_hits.assign(transition_num, 0);
+    transition_names.clear();
+    transition_states.clear();
+    wildcard.clear();
+    state_names.clear();
+    high_water.clear();
+    steps = 0;
+    seconds = 0;
+}
+
+std::vector<long long> RunProfile::stateHits() const {
+    std::vector<long long> hits(state_names.size(), 0);
+    for (size_t t = 0; t < transition_hits.size() && t < transition_states.size(); t++) {
+        hits[transition_states[t]] += transition_hits[t];
+    }
+    return hits;
+}
+
+void RunProfile::writeText(std::ostream &out) const {
+    long long wildcard_steps = 0;
+    size_t unused = 0;
+    for (size_t t = 0; t < transition_hits.size(); t++) {
+        if (wildcard[t]) {
+            wildcard_steps += transition_hits[t];
+        }
+        if (transition_hits[t] == 0) {
+            unused++;
+        }
+    }
+
+    out << "=================== PROFILE ===================\n";
+    out << "Steps      : " << steps << "\n";
+    out << std::fixed << std::setprecision(3);
+    out << "Time       : " << seconds << " s";
+    if (seconds > 0) {
+        out << std::setprecision(0) << " (" << static_cast<double>(steps) / seconds << " steps/s)";
+    }
+    out << "\n" << std::setprecision(1);
+    std::string label = wildcard_label;
+    if (!label.empty()) {
+        label[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(label[0])));
+    }
+    out << std::left << std::setw(11) << label << std::right << ": " << 100 * fraction(wildcard_steps, steps)
+        << "% of steps\n";
+    out << "High water :";
+    for (size_t i = 0; i < high_water.size(); i++) {
+        out << (i == 0 ? " " : ", ") << high_water[i].first << " = " << high_water[i].second;
+    }
+    out << "\n";
+
+    std::vector<long long> state_hits = stateHits();
+    out << "------------------- states --------------------\n";
+    for (size_t q : byCount(state_hits)) {
+        out << std::setw(12) << state_hits[q] << std::setw(7) << 100 * fraction(state_hits[q], steps) << "%  "
+            << state_names[q] << "\n";
+    }
+    out << "----------------- transitions -----------------\n";
+    for (size_t t : byCount(transition_hits)) {
+        if (transition_hits[t] == 0) {
+            break;
+        }
+        out << std::setw(12) << transition_hits[t] << std::setw(7) << 100 * fraction(transition_hits[t], steps)
+            << "%  " << transition_names[t] << (wildcard[t] ? "  (" + wildcard_label + ")" : "") << "\n";
+    }
+    if (unused > 0) {
+        out << unused << " transitions never used\n";
+    }
+    out << "===============================================\n";
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+}
+
+void RunProfile::writeJson(std::ostream &out) const {
+    long long wildcard_steps = 0;
+    for (size_t t = 0; t < transition_hits.size(); t++) {
+        if (wildcard[t]) {
+            wildcard_steps += transition_hits[t];
+        }
+    }
+
+    out << std::setprecision(17);
+    out << "{\n";
+    out << "  \"machine\": " << jsonString(machine) << ",\n";
+    out << "  \"steps\": " << steps << ",\n";
+    out << "  \"seconds\": " << seconds << ",\n";
+    out << "  \"steps_per_second\": " << (seconds > 0 ? static_cast<double>(steps) / seconds : 0.0) << ",\n";
+    out << "  \"" << wildcard_label << "_steps\": " << wildcard_steps << ",\n";
+    out << "  \"" << wildcard_label << "_fraction\": " << fraction(wildcard_steps, steps) << ",\n";
+    out << "  \"high_water\": {";
+    for (size_t i = 0; i < high_water.size(); i++) {
+        out << (i == 0 ? "" : ", ") << jsonString(high_water[i].first) << ": " << high_water[i].second;
+    }
+    out << "},\n";
+
+    std::vector<long long> state_hits = stateHits();
+    out << "  \"states\": [";
+    bool first = true;
+    for (size_t q : byCount(state_hits)) {
+        out << (first ? "\n" : ",\n") << "    {\"name\": " << jsonString(state_names[q])
+            << ", \"steps\": " << state_hits[q] << "}";
+        first = false;
+    }
+    out << "\n  ],\n";
+
+    out << "  \"transitions\": [";
+    first = true;
+    for (size_t t : byCount(transition_hits)) {
+        out << (first ? "\n" : ",\n") << "    {\"id\": " << t << ", \"rule\": " << jsonString(transition_names[t])
+            << ", \"hits\": " << transition_hits[t] << ", \"" << wildcard_label
+            << "\": " << (wildcard[t] ? "true" : "false") << "}";
+        first = false;
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+    out << std::setprecision(6);
+}
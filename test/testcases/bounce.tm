@@ -0,0 +1,30 @@
+; This program never halts: the head sweeps back and forth over the input forever.
+; Input: a string of 1's, e.g. '111'
+
+; the finite set of states
+#Q = {right,left}
+
+; the finite set of input symbols
+#S = {1}
+
+; the complete set of tape symbols
+#G = {1,_}
+
+; the start state
+#q0 = right
+
+; the blank symbol
+#B = _
+
+; the set of final states
+#F = {}
+
+; the number of tapes
+#N = 1
+
+; the transition functions
+
+right 1 1 r right
+right _ _ l left
+left 1 1 l left
+left _ _ r right
@@ -0,0 +1,27 @@
+; This program never halts: it writes 1's to the right of the input forever, so the tape keeps growing.
+; Input: a string of 1's, e.g. '111'
+
+; the finite set of states
+#Q = {run}
+
+; the finite set of input symbols
+#S = {1}
+
+; the finite set of tape symbols
+#G = {1,_}
+
+; the start state
+#q0 = run
+
+; the blank symbol
+#B = _
+
+; the set of final states
+#F = {}
+
+; the number of tapes
+#N = 1
+
+; the transition functions
+run 1 1 r run
+run _ 1 r run
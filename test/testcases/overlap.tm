@@ -0,0 +1,22 @@
+; A two-tape machine whose wildcard transitions overlap on '00'
+
+#Q = {q0,left,right}
+
+#S = {0,1}
+
+#G = {0,1,_}
+
+#q0 = q0
+
+#B = _
+
+#F = {left,right}
+
+#N = 2
+
+; both transitions match '00' with one wildcard each, the first one is used
+q0 0* ** ** left
+q0 *0 ** ** right
+; '1*' and '*0' also overlap, but the exact transition on '10' covers it
+q0 1* ** ** left
+q0 10 ** ** left